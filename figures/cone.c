@@ -15,17 +15,18 @@
 #include "cone.h"
 
 /*
- * Returns a pointer to the intersection between a cone and a ray.
+ * Finds the intersections between a cone and a ray. Returns the number of
+ * intersections found.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized.
  * object_ptr: Pointer to the Object struct that represents the cone.
- * length: Output parameter for the number of intersections found.
+ * inter_list: Output list for the intersections found.
  */
-void* get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
 {
 	Cone* cone_ptr =  (Cone*) ((Object*)object_ptr)->figure;
-	long double termQD, termQE;
+	Real termQD, termQE;
 	Vector varD, varE, anchor_to_anchor;
 	anchor_to_anchor = subtract_vectors(eye, cone_ptr->anchor);
 
@@ -35,11 +36,11 @@ void* get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *l
 	varD = subtract_vectors(multiply_vector(termQD, cone_ptr->direction), dir_vec);
 	varE = get_ray_position(cone_ptr->anchor, subtract_vectors(multiply_vector(termQE, cone_ptr->direction), eye), 1);
 
-	long double a = pow(varD.x, 2) + pow(varD.y, 2) + pow(varD.z, 2) - pow(cone_ptr->radius, 2) * pow(termQD, 2);
-	long double b = 2 * (do_dot_product(varE, varD) - pow(cone_ptr->radius, 2) * termQD * termQE);
-	long double c = pow(varE.x, 2) + pow(varE.y, 2) + pow(varE.z, 2) - pow(cone_ptr->radius, 2) * pow(termQE, 2);
+	Real a = do_dot_product(varD, varD) - cone_ptr->radius_pow * (termQD * termQD);
+	Real b = 2 * (do_dot_product(varE, varD) - cone_ptr->radius_pow * termQD * termQE);
+	Real c = do_dot_product(varE, varE) - cone_ptr->radius_pow * (termQE * termQE);
 
-	return get_cyl_cone_intersection(a, b, c, eye, dir_vec, object_ptr, length);
+	return get_cyl_cone_intersection(a, b, c, eye, dir_vec, object_ptr, inter_list);
 }
 
 /*
@@ -48,16 +49,38 @@ void* get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *l
  *
  * posn: Position at which the intersection occured
  * cone_ptr: Pointer to a cone figure.
+ * primitive: Unused, cones are a single surface.
  */
-Vector get_cone_normal_vector(Vector posn, void* cone_ptr)
+Vector get_cone_normal_vector(Vector posn, void* cone_ptr, int primitive)
 {
 	Cone cone = *((Cone*) cone_ptr);
 	Vector border, normal_vec;
 	border = subtract_vectors(posn, cone.anchor);
-	long double distance = normalize_vector(&border);
+	Real distance = normalize_vector(&border);
 	if(do_dot_product(border, cone.direction) < 0)
 		distance *= -1;
-	normal_vec = multiply_vector(1.0/ fabsl(distance), subtract_vectors(posn, get_ray_position(cone.anchor, cone.direction, distance * sqrt(2))));
+	normal_vec = multiply_vector(1.0/ real_abs(distance), subtract_vectors(posn, get_ray_position(cone.anchor, cone.direction, distance * real_sqrt(2))));
 	normalize_vector(&normal_vec);
 	return normal_vec;
 }
+
+/*
+ * Calculates the box that encloses a cone. Only finite cones are bounded. The
+ * widest parts of the cone are its ends, so the box encloses both end circles
+ * and the anchor where both cones meet.
+ *
+ * cone_ptr: Pointer to a cone figure.
+ * box: Output parameter for the box of the cone.
+ */
+int get_cone_bounds(void* cone_ptr, BoundingBox *box)
+{
+	Cone cone = *((Cone*) cone_ptr);
+	if(!cone.is_finite) return 0;
+	*box = merge_boxes(
+		get_circle_bounds(get_ray_position(cone.anchor, cone.direction, cone.front_length),
+						  cone.direction, cone.radius * real_abs(cone.front_length)),
+		get_circle_bounds(get_ray_position(cone.anchor, cone.direction, cone.back_length),
+						  cone.direction, cone.radius * real_abs(cone.back_length)));
+	*box = add_point_to_box(*box, cone.anchor);
+	return 1;
+}
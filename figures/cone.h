@@ -14,10 +14,12 @@
  * front_length: Length of the cone that points to 'direction'.
  * back_length: Length of the cone that point to inverse 'direction'.
  * anchor: Point from which both cones emerge.
+ * radius_pow: Squared width::height ratio.
  */
 typedef Cylinder Cone;
 
-void* get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_cone_normal_vector(Vector posn, void* cone_ptr);
+int get_cone_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_cone_normal_vector(Vector posn, void* cone_ptr, int primitive);
+int get_cone_bounds(void* cone_ptr, BoundingBox *box);
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef COORD_2D_H
 #define COORD_2D_H
 
+#include "../tracing/real.h"
+
 /*
  * Represens a 2D coordinate. Its used for 2d "maps" such as polygons,
  * textures, etc.
@@ -10,8 +12,8 @@
  */
 typedef struct
 {
-	long double u;
-	long double v;
+	Real u;
+	Real v;
 } Coord2D;
 
 #endif
@@ -23,28 +23,26 @@
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized.
  * object_ptr: Pointer to the Object struct that represents the cylinder or cone.
- * length: Output parameter for the number of intersections found.
+ * inter_found: Output list for the intersections found. Returns its length.
  */
-Intersection* get_cyl_cone_intersection(long double a, long double b, long double c,
-	Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_cyl_cone_intersection(Real a, Real b, Real c,
+	Vector eye, Vector dir_vec, void* object_ptr, Intersection *inter_found)
 {
-    long double l_distance;
-    long double *distances;
-    Intersection *inter_found;
+    Real l_distance;
+    Real distances[2];
+    int length;
 	Cylinder* cyl_ptr =  (Cylinder*) ((Object*)object_ptr)->figure;
     // We obtain the distance between the eye and both of the cylinder/cone intersections
-    distances = do_cuadratic_function(a, b, c);
-    if (!distances) return NULL;
+    length = do_cuadratic_function(a, b, c, distances);
 
     // We create the intersection object according to the distance
-    *length = is_one_distance(distances) ? 1 : 2;
-    inter_found = get_memory(sizeof(Intersection) * *length, NULL);
     int inter_i;
-    for(inter_i = 0; inter_i < *length; inter_i++)
+    for(inter_i = 0; inter_i < length; inter_i++)
     {
-        inter_found[inter_i].posn = get_ray_position(eye, dir_vec, distances[inter_i] - 0.001);
+        inter_found[inter_i].posn = get_ray_position(eye, dir_vec, distances[inter_i] - REAL_TOLERANCE);
         inter_found[inter_i].distance = distances[inter_i];
-        inter_found[inter_i].obj = *((Object*)object_ptr);
+        inter_found[inter_i].obj = (Object*) object_ptr;
+        inter_found[inter_i].primitive = 0;
         if(cyl_ptr->is_finite)
         {
             l_distance = do_dot_product(cyl_ptr->direction, subtract_vectors(inter_found[inter_i].posn, cyl_ptr->anchor));
@@ -57,24 +55,23 @@ Intersection* get_cyl_cone_intersection(long double a, long double b, long doubl
         }
 
     }
-    free(distances);
-    return inter_found;
+    return length;
 }
 
 /*
- * Returns a pointer to the intersection between a cylinder and a ray.
+ * Finds the intersections between a cylinder and a ray. Returns the number of
+ * intersections found.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized.
  * object_ptr: Pointer to the Object struct that represents the cylinder
- * length: Output parameter for the number of intersections found.
+ * inter_list: Output list for the intersections found.
  */
-void* get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
 {
-    *length = 1;
 	Cylinder* cyl_ptr =  (Cylinder*) ((Object*)object_ptr)->figure;
 
-	long double termQD, termQE;
+	Real termQD, termQE;
 	Vector varD, varE, anchor_to_anchor;
 
 	anchor_to_anchor = subtract_vectors(eye, cyl_ptr->anchor);
@@ -86,11 +83,11 @@ void* get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, in
 	varE = get_ray_position(cyl_ptr->anchor, subtract_vectors(multiply_vector(termQE, cyl_ptr->direction), eye), 1);
 
 	//Obtenemos el discriminante
-	long double a = pow(varD.x, 2) + pow(varD.y, 2) + pow(varD.z, 2);
-	long double b = 2 * do_dot_product(varE, varD);
-	long double c = pow(varE.x, 2) + pow(varE.y, 2) + pow(varE.z, 2) - pow(cyl_ptr->radius, 2);
+	Real a = do_dot_product(varD, varD);
+	Real b = 2 * do_dot_product(varE, varD);
+	Real c = do_dot_product(varE, varE) - cyl_ptr->radius_pow;
 
-	return get_cyl_cone_intersection(a, b, c, eye, dir_vec, object_ptr, length);
+	return get_cyl_cone_intersection(a, b, c, eye, dir_vec, object_ptr, inter_list);
 }
 
 /*
@@ -99,11 +96,49 @@ void* get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, in
  *
  * posn: Position at which the intersection occured
  * cylinder_ptr: Pointer to a cylinder figure.
+ * primitive: Unused, cylinders are a single surface.
  */
-Vector get_cylinder_normal_vector(Vector posn, void* cylinder_ptr)
+Vector get_cylinder_normal_vector(Vector posn, void* cylinder_ptr, int primitive)
 {
 	Cylinder cyl = *((Cylinder*) cylinder_ptr);
-	long double m_distance = do_dot_product(cyl.direction, subtract_vectors(posn, cyl.anchor));
-	Vector normal_vector = multiply_vector(1.0 / cyl.radius, subtract_vectors(posn, get_ray_position(cyl.anchor, cyl.direction, m_distance)));
+	Real m_distance = do_dot_product(cyl.direction, subtract_vectors(posn, cyl.anchor));
+	Vector normal_vector = multiply_vector(cyl.inv_radius, subtract_vectors(posn, get_ray_position(cyl.anchor, cyl.direction, m_distance)));
 	return normal_vector;
 }
+
+/*
+ * Returns the box that encloses a circle. The circle spreads on each axis
+ * according to how perpendicular the axis is to the circle's normal.
+ *
+ * center: Center of the circle.
+ * axis: Normal of the circle. Must be normalized.
+ * radius: Radius of the circle.
+ */
+BoundingBox get_circle_bounds(Vector center, Vector axis, Real radius)
+{
+	BoundingBox box;
+	Vector extent;
+	extent.x = radius * real_sqrt(real_max(0.0, 1.0 - axis.x * axis.x));
+	extent.y = radius * real_sqrt(real_max(0.0, 1.0 - axis.y * axis.y));
+	extent.z = radius * real_sqrt(real_max(0.0, 1.0 - axis.z * axis.z));
+	box.min = subtract_vectors(center, extent);
+	box.max = get_ray_position(center, extent, 1);
+	return box;
+}
+
+/*
+ * Calculates the box that encloses a cylinder. Only finite cylinders are
+ * bounded.
+ *
+ * cylinder_ptr: Pointer to a cylinder figure.
+ * box: Output parameter for the box of the cylinder.
+ */
+int get_cylinder_bounds(void* cylinder_ptr, BoundingBox *box)
+{
+	Cylinder cyl = *((Cylinder*) cylinder_ptr);
+	if(!cyl.is_finite) return 0;
+	*box = merge_boxes(
+		get_circle_bounds(get_ray_position(cyl.anchor, cyl.direction, cyl.front_length), cyl.direction, cyl.radius),
+		get_circle_bounds(get_ray_position(cyl.anchor, cyl.direction, cyl.back_length), cyl.direction, cyl.radius));
+	return 1;
+}
@@ -16,21 +16,27 @@
  *               direction. It's normally positive.
  * back_length: Length at which the cylinder spreads towards the 'direction'
  *              inverse direction. It's normally negative.
+ * radius_pow: Squared radius. Calculated when the cylinder is loaded.
+ * inv_radius: Inverse of the radius. Calculated when the cylinder is loaded.
  */
 typedef struct
 {
 	Vector direction;
 	Vector anchor;
-	long double radius;
+	Real radius;
 	int is_finite;
-	long double front_length;
-	long double back_length;
+	Real front_length;
+	Real back_length;
+	Real radius_pow;
+	Real inv_radius;
 } Cylinder;
 
-Intersection* get_cyl_cone_intersection(
-    long double a, long double b, long double c,
-    Vector eye, Vector dir_vec, void* object_ptr, int *length);
-void* get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_cylinder_normal_vector(Vector posn, void* cylinder_ptr);
+int get_cyl_cone_intersection(
+    Real a, Real b, Real c,
+    Vector eye, Vector dir_vec, void* object_ptr, Intersection *inter_list);
+int get_cylinder_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_cylinder_normal_vector(Vector posn, void* cylinder_ptr, int primitive);
+BoundingBox get_circle_bounds(Vector center, Vector axis, Real radius);
+int get_cylinder_bounds(void* cylinder_ptr, BoundingBox *box);
 
 #endif
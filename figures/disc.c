@@ -16,49 +16,41 @@
 
 /*
  * Returns true if a point is inside an elipsis defined by 2 focus points and a
- * maximum distance at which any point within the elipsis can exist.
+ * maximum distance at which any point within the elipsis can exist. Only the
+ * distances to the focus points are needed, so the vectors aren't normalized.
  *
  * posn: Position that is being checked if is inside the elipsis/disc.
  * focus1: First focus point that defines the elipsis.
  * focus2: Second focus point that defines the elipsis.
  * max_dist: Maximum distance at which any point within the elipsis can exist.
  */
-int is_inside_disc(Vector posn, Vector focus1, Vector focus2, long double max_dist)
+int is_inside_disc(Vector posn, Vector focus1, Vector focus2, Real max_dist)
 {
-    Vector focus1_vector = subtract_vectors(posn, focus1);
-    Vector focus2_vector = subtract_vectors(posn, focus2);
-    long double focus1_distance = normalize_vector(&focus1_vector);
-    long double focus2_distance = normalize_vector(&focus2_vector);
+    Real focus1_distance = get_vector_length(subtract_vectors(posn, focus1));
+    Real focus2_distance = get_vector_length(subtract_vectors(posn, focus2));
     return (max_dist > focus1_distance + focus2_distance);
 }
 
 /*
- * Returns a pointer to the intersection between a disc and a ray.
+ * Finds the intersection between a disc and a ray. Returns the number of
+ * intersections found.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized.
  * object_ptr: Pointer to the Object struct that represents the disc.
- * length: Output parameter for the number of intersections found.
+ * inter_list: Output list for the intersections found.
  */
-void* get_disc_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_disc_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
 {
-    *length = 1;
 	Disc* disc_ptr =  (Disc*) ((Object*)object_ptr)->figure;
+	Intersection* inter = (Intersection*) inter_list;
 	// We get the disc's plane intersection
-	((Object*)object_ptr)->figure = &(disc_ptr->plane);
-	Intersection* inter = get_plane_intersection(eye, dir_vec, object_ptr, NULL);
-	((Object*)object_ptr)->figure = disc_ptr;
-	if(inter)
+	if(get_embedded_plane_intersection(eye, dir_vec, &(disc_ptr->plane), object_ptr, inter))
 	{
-		if(!is_inside_disc(inter->posn, disc_ptr->inner_focus1, disc_ptr->inner_focus2, disc_ptr->inner_dist) &&
-           is_inside_disc(inter->posn, disc_ptr->ext_focus1, disc_ptr->ext_focus2, disc_ptr->ext_dist))
-        {
-           *length = 1;
-           return inter;
-        }
-		else free(inter);
+		return !is_inside_disc(inter->posn, disc_ptr->inner_focus1, disc_ptr->inner_focus2, disc_ptr->inner_dist) &&
+               is_inside_disc(inter->posn, disc_ptr->ext_focus1, disc_ptr->ext_focus2, disc_ptr->ext_dist);
 	}
-	return NULL;
+	return 0;
 }
 
 /*
@@ -67,8 +59,28 @@ void* get_disc_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *l
  *
  * posn: Position at which the intersection occured
  * disc_ptr: Pointer to a disc figure.
+ * primitive: Unused, discs are a single surface.
  */
-Vector get_disc_normal_vector(Vector posn, void* disc_ptr)
+Vector get_disc_normal_vector(Vector posn, void* disc_ptr, int primitive)
 {
-	return get_plane_normal_vector(posn, &((Disc*) disc_ptr)->plane);
+	return get_plane_normal_vector(posn, &((Disc*) disc_ptr)->plane, primitive);
+}
+
+/*
+ * Calculates the box that encloses a disc. Every point of the disc elipsis is
+ * at most half the 'ext_dist' away from the middle of its focus points, so
+ * the box of that sphere encloses the disc.
+ *
+ * disc_ptr: Pointer to a disc figure.
+ * box: Output parameter for the box of the disc.
+ */
+int get_disc_bounds(void* disc_ptr, BoundingBox *box)
+{
+	Disc disc = *((Disc*) disc_ptr);
+	Vector center = multiply_vector(0.5, get_ray_position(disc.ext_focus1, disc.ext_focus2, 1));
+	Real half_dist = disc.ext_dist / 2.0;
+	Vector half_dist_vec = (Vector){ .x = half_dist, .y = half_dist, .z = half_dist };
+	box->min = subtract_vectors(center, half_dist_vec);
+	box->max = get_ray_position(center, half_dist_vec, 1);
+	return 1;
 }
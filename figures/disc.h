@@ -2,6 +2,7 @@
 #define DISC_H
 
 #include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
 #include "plane.h"
 
 /*
@@ -21,13 +22,14 @@ typedef struct
 	Plane plane;
 	Vector inner_focus1;
 	Vector inner_focus2;
-	long double inner_dist;
+	Real inner_dist;
 	Vector ext_focus1;
 	Vector ext_focus2;
-	long double ext_dist;
+	Real ext_dist;
 } Disc;
 
-void* get_disc_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_disc_normal_vector(Vector posn, void* disc_ptr);
+int get_disc_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_disc_normal_vector(Vector posn, void* disc_ptr, int primitive);
+int get_disc_bounds(void* disc_ptr, BoundingBox *box);
 
 #endif
@@ -0,0 +1,423 @@
+/* heightfield.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains all the heightfield object functions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../utilities/memory_handler.h"
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/intersection.h"
+#include "../tracing/bounding_box.h"
+#include "heightfield.h"
+
+/*
+ * Returns the height of a sample of a heightfield.
+ *
+ * field: Heightfield where the sample is.
+ * column: Column (X) of the sample.
+ * row: Row (Z) of the sample.
+ */
+Real get_sample_height(const Heightfield *field, int column, int row)
+{
+    return field->heights[row * field->columns + column];
+}
+
+/*
+ * Returns the number of blocks of a pyramid level along an axis.
+ *
+ * cells: Number of cells along the axis.
+ * level: Level of the pyramid.
+ */
+int get_level_blocks(int cells, int level)
+{
+    return (cells + (1 << level) - 1) >> level;
+}
+
+/*
+ * Gets the lowest and highest heights of a block of a heightfield. Blocks of
+ * the level 0 are single cells, so their heights are taken from the samples.
+ *
+ * field: Heightfield where the block is.
+ * level: Level of the pyramid of the block.
+ * block_x: Position of the block along the X axis.
+ * block_z: Position of the block along the Z axis.
+ * low: Output parameter for the lowest height.
+ * high: Output parameter for the highest height.
+ */
+void get_block_heights(const Heightfield *field, int level, int block_x, int block_z, Real *low, Real *high)
+{
+    Real height00, height10, height01, height11;
+    const float *block;
+    if(level == 0)
+    {
+        height00 = get_sample_height(field, block_x, block_z);
+        height10 = get_sample_height(field, block_x + 1, block_z);
+        height01 = get_sample_height(field, block_x, block_z + 1);
+        height11 = get_sample_height(field, block_x + 1, block_z + 1);
+        *low = real_min(real_min(height00, height10), real_min(height01, height11));
+        *high = real_max(real_max(height00, height10), real_max(height01, height11));
+        return;
+    }
+    block = &field->pyramid[2 * (field->level_starts[level] + block_z * field->level_columns[level] + block_x)];
+    *low = block[0];
+    *high = block[1];
+}
+
+/*
+ * Builds the pyramid of blocks of a heightfield, and finds its lowest and
+ * highest heights. It must be called after the heights are loaded.
+ *
+ * field: Heightfield that is prepared.
+ */
+void prepare_heightfield(Heightfield *field)
+{
+    Real low, high, child_low, child_high;
+    int cells_x, cells_z, level, blocks_length, block_x, block_z, child_x, child_z;
+    size_t sample_i;
+    float *block;
+
+    field->min_height = field->max_height = field->heights[0];
+    for(sample_i = 0; sample_i < (size_t) field->columns * field->rows; sample_i++)
+    {
+        field->min_height = real_min(field->min_height, field->heights[sample_i]);
+        field->max_height = real_max(field->max_height, field->heights[sample_i]);
+    }
+    cells_x = field->columns - 1;
+    cells_z = field->rows - 1;
+    for(field->levels = 0; (1 << field->levels) < cells_x || (1 << field->levels) < cells_z; field->levels++);
+    field->level_starts = (int*) get_memory(sizeof(int) * (field->levels + 1), NULL);
+    field->level_columns = (int*) get_memory(sizeof(int) * (field->levels + 1), NULL);
+    blocks_length = 0;
+    for(level = 1; level <= field->levels; level++)
+    {
+        field->level_starts[level] = blocks_length;
+        field->level_columns[level] = get_level_blocks(cells_x, level);
+        blocks_length += field->level_columns[level] * get_level_blocks(cells_z, level);
+    }
+    field->pyramid = (float*) get_memory(sizeof(float) * (2 * blocks_length + 1), NULL);
+    // Each block encloses the (up to) four blocks of the level below
+    for(level = 1; level <= field->levels; level++)
+    {
+        for(block_z = 0; block_z < get_level_blocks(cells_z, level); block_z++)
+        for(block_x = 0; block_x < field->level_columns[level]; block_x++)
+        {
+            low = INFINITY;
+            high = -INFINITY;
+            for(child_z = 2 * block_z; child_z < 2 * block_z + 2 && child_z < get_level_blocks(cells_z, level - 1); child_z++)
+            for(child_x = 2 * block_x; child_x < 2 * block_x + 2 && child_x < get_level_blocks(cells_x, level - 1); child_x++)
+            {
+                get_block_heights(field, level - 1, child_x, child_z, &child_low, &child_high);
+                low = real_min(low, child_low);
+                high = real_max(high, child_high);
+            }
+            block = &field->pyramid[2 * (field->level_starts[level] + block_z * field->level_columns[level] + block_x)];
+            block[0] = low;
+            block[1] = high;
+        }
+    }
+}
+
+/*
+ * Shrinks the range of distances of a ray to the ones where a coordinate of
+ * the ray is between two limits. Returns false if the range gets empty.
+ *
+ * origin: Coordinate of the eye.
+ * dir: Coordinate of the direction of the ray.
+ * low, high: Limits of the coordinate.
+ * near_distance, far_distance: Input/Output parameters for the range.
+ */
+int clip_ray_range(Real origin, Real dir, Real low, Real high, Real *near_distance, Real *far_distance)
+{
+    Real low_distance, high_distance;
+    if(dir == 0) return origin >= low && origin <= high;
+    low_distance = (low - origin) / dir;
+    high_distance = (high - origin) / dir;
+    *near_distance = real_max(*near_distance, real_min(low_distance, high_distance));
+    *far_distance = real_min(*far_distance, real_max(low_distance, high_distance));
+    return *near_distance <= *far_distance;
+}
+
+/*
+ * Returns the block of a pyramid level where a coordinate of a ray is. A ray
+ * that is on the border of two blocks is in the one towards which it moves.
+ *
+ * posn: Coordinate of the ray, in cells.
+ * dir: Coordinate of the direction of the ray.
+ * block_size: Number of cells of the blocks along the axis.
+ * blocks: Number of blocks along the axis.
+ */
+int get_ray_block(Real posn, Real dir, int block_size, int blocks)
+{
+    int block = (int) real_floor(posn / block_size);
+    if(dir < 0 && block * block_size == posn) block--;
+    if(block < 0) return 0;
+    if(block >= blocks) return blocks - 1;
+    return block;
+}
+
+/*
+ * Returns the smaller block of a pyramid level where a coordinate of a ray is,
+ * among the two children of a block of the level above. It keeps the walk
+ * inside the block it goes down from, even when the coordinate is rounded
+ * towards a neighbour.
+ *
+ * posn: Coordinate of the ray, in cells.
+ * dir: Coordinate of the direction of the ray.
+ * level: Level of the pyramid of the smaller block.
+ * parent: Position of the block of the level above along the axis.
+ * cells: Number of cells along the axis.
+ */
+int get_child_block(Real posn, Real dir, int level, int parent, int cells)
+{
+    int block = get_ray_block(posn, dir, 1 << level, get_level_blocks(cells, level));
+    if(block < 2 * parent) return 2 * parent;
+    if(block > 2 * parent + 1) return 2 * parent + 1;
+    return block;
+}
+
+/*
+ * Returns true if a ray hits a triangle, and writes the distance to the hit.
+ * The triangles of both sides are hit.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown.
+ * vertex1, vertex2, vertex3: Corners of the triangle.
+ * distance: Output parameter for the distance to the hit.
+ */
+int hit_cell_triangle(Vector eye, Vector dir_vec, Vector vertex1, Vector vertex2, Vector vertex3, Real *distance)
+{
+    Vector edge1, edge2, dir_cross, eye_vec, eye_cross;
+    Real det, u, v;
+
+    edge1 = subtract_vectors(vertex2, vertex1);
+    edge2 = subtract_vectors(vertex3, vertex1);
+    dir_cross = do_cross_product(dir_vec, edge2);
+    det = do_dot_product(edge1, dir_cross);
+    if(det == 0) return 0;
+    eye_vec = subtract_vectors(eye, vertex1);
+    u = do_dot_product(eye_vec, dir_cross) / det;
+    if(u < 0 || u > 1) return 0;
+    eye_cross = do_cross_product(eye_vec, edge1);
+    v = do_dot_product(dir_vec, eye_cross) / det;
+    if(v < 0 || u + v > 1) return 0;
+    *distance = do_dot_product(edge2, eye_cross) / det;
+    return 1;
+}
+
+/*
+ * Finds the intersections between a heightfield and a ray. Returns the number
+ * of intersections found. Only the nearest one is searched for opaque objects
+ * without cutting planes, otherwise the MAX_FIGURE_INTERSECTIONS nearest ones.
+ * The ray walks the blocks of the pyramid from the nearest to the farthest. A
+ * block that the ray goes above or below is skipped, otherwise the ray walks
+ * its smaller blocks, down to the cells, whose triangles are tested. The blocks
+ * are walked by their positions, like a DDA: leaving a block moves to its
+ * neighbour along the axis crossed, so the walk always moves forward whatever
+ * the precision of the distances. The ray is moved to the space of the cells
+ * (one unit per cell) first, which keeps the distances.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * object_ptr: Pointer to the Object struct that represents the heightfield.
+ * inter_list: Output list for the intersections found.
+ */
+int get_heightfield_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
+{
+    Object *obj = (Object*) object_ptr;
+    Heightfield *field = (Heightfield*) obj->figure;
+    Intersection *inter_found = (Intersection*) inter_list;
+    Vector cell_eye, cell_dir_vec, corner00, corner10, corner01, corner11;
+    Real distance, exit_distance, block_exit_distance, exit_x, exit_z, low, high, ray_low, ray_high, swap_distance;
+    Real distances[MAX_FIGURE_INTERSECTIONS], cell_distances[2];
+    int primitives[MAX_FIGURE_INTERSECTIONS];
+    int cells_x, cells_z, level, block_size, block_x, block_z, next_x, next_z, max_length, length, cell_hits, hit_i, triangle_i;
+
+    if(obj->transparency_material > 0.0 || obj->translucency_material > 0.0 || obj->cutting_planes_length > 0)
+        max_length = MAX_FIGURE_INTERSECTIONS;
+    else
+        max_length = 1;
+    cells_x = field->columns - 1;
+    cells_z = field->rows - 1;
+    cell_eye = (Vector){ .x = (eye.x - field->anchor.x) / field->cell_x, .y = eye.y, .z = (eye.z - field->anchor.z) / field->cell_z };
+    cell_dir_vec = (Vector){ .x = dir_vec.x / field->cell_x, .y = dir_vec.y, .z = dir_vec.z / field->cell_z };
+    distance = 0;
+    exit_distance = INFINITY;
+    if(!clip_ray_range(cell_eye.x, cell_dir_vec.x, 0, cells_x, &distance, &exit_distance) ||
+       !clip_ray_range(cell_eye.z, cell_dir_vec.z, 0, cells_z, &distance, &exit_distance) ||
+       !clip_ray_range(cell_eye.y, cell_dir_vec.y, field->min_height, field->max_height, &distance, &exit_distance))
+        return 0;
+    // The last level has a single block
+    level = field->levels;
+    block_x = block_z = 0;
+    length = 0;
+    while(length < max_length)
+    {
+        block_size = 1 << level;
+        // Distances at which the ray leaves the block along each axis
+        exit_x = exit_z = INFINITY;
+        if(cell_dir_vec.x > 0) exit_x = ((block_x + 1) * block_size - cell_eye.x) / cell_dir_vec.x;
+        if(cell_dir_vec.x < 0) exit_x = (block_x * block_size - cell_eye.x) / cell_dir_vec.x;
+        if(cell_dir_vec.z > 0) exit_z = ((block_z + 1) * block_size - cell_eye.z) / cell_dir_vec.z;
+        if(cell_dir_vec.z < 0) exit_z = (block_z * block_size - cell_eye.z) / cell_dir_vec.z;
+        block_exit_distance = real_min(exit_distance, real_min(exit_x, exit_z));
+        get_block_heights(field, level, block_x, block_z, &low, &high);
+        ray_low = cell_eye.y + cell_dir_vec.y * (cell_dir_vec.y > 0 ? distance : block_exit_distance);
+        ray_high = cell_eye.y + cell_dir_vec.y * (cell_dir_vec.y > 0 ? block_exit_distance : distance);
+        if(ray_low <= high + REAL_TOLERANCE && ray_high >= low - REAL_TOLERANCE)
+        {
+            if(level > 0)
+            {
+                level--;
+                block_x = get_child_block(cell_eye.x + cell_dir_vec.x * distance, cell_dir_vec.x, level, block_x, cells_x);
+                block_z = get_child_block(cell_eye.z + cell_dir_vec.z * distance, cell_dir_vec.z, level, block_z, cells_z);
+                continue;
+            }
+            corner00 = (Vector){ .x = block_x, .y = get_sample_height(field, block_x, block_z), .z = block_z };
+            corner10 = (Vector){ .x = block_x + 1, .y = get_sample_height(field, block_x + 1, block_z), .z = block_z };
+            corner01 = (Vector){ .x = block_x, .y = get_sample_height(field, block_x, block_z + 1), .z = block_z + 1 };
+            corner11 = (Vector){ .x = block_x + 1, .y = get_sample_height(field, block_x + 1, block_z + 1), .z = block_z + 1 };
+            cell_hits = 0;
+            if(hit_cell_triangle(cell_eye, cell_dir_vec, corner00, corner10, corner11, &cell_distances[cell_hits]) &&
+               cell_distances[cell_hits] > INTER_EPSILON)
+                cell_hits++;
+            if(hit_cell_triangle(cell_eye, cell_dir_vec, corner00, corner11, corner01, &cell_distances[cell_hits]) &&
+               cell_distances[cell_hits] > INTER_EPSILON)
+                cell_hits++;
+            // The cells are walked in order, so the hits of a cell are behind the ones found before
+            if(cell_hits == 2 && cell_distances[1] < cell_distances[0])
+            {
+                swap_distance = cell_distances[0];
+                cell_distances[0] = cell_distances[1];
+                cell_distances[1] = swap_distance;
+            }
+            for(triangle_i = 0; triangle_i < cell_hits && length < max_length; triangle_i++)
+            {
+                distances[length] = cell_distances[triangle_i];
+                primitives[length++] = block_z * cells_x + block_x;
+            }
+        }
+        if(block_exit_distance >= exit_distance)
+            break;
+        // Leave the block towards its neighbour along the axis crossed
+        distance = real_max(distance, block_exit_distance);
+        next_x = block_x;
+        next_z = block_z;
+        if(exit_x <= exit_z)
+            next_x += cell_dir_vec.x > 0 ? 1 : -1;
+        else
+            next_z += cell_dir_vec.z > 0 ? 1 : -1;
+        if(next_x < 0 || next_x >= get_level_blocks(cells_x, level) || next_z < 0 || next_z >= get_level_blocks(cells_z, level))
+            break;
+        // Look for larger blocks to skip, while the neighbour is not in the same block of the level above
+        while(level < field->levels && (next_x >> 1 != block_x >> 1 || next_z >> 1 != block_z >> 1))
+        {
+            block_x >>= 1;
+            block_z >>= 1;
+            next_x >>= 1;
+            next_z >>= 1;
+            level++;
+        }
+        block_x = next_x;
+        block_z = next_z;
+    }
+    for(hit_i = 0; hit_i < length; hit_i++)
+    {
+        inter_found[hit_i].posn = get_ray_position(eye, dir_vec, distances[hit_i]);
+        inter_found[hit_i].distance = distances[hit_i];
+        inter_found[hit_i].obj = obj;
+        inter_found[hit_i].is_valid = 1;
+        inter_found[hit_i].primitive = primitives[hit_i];
+    }
+    return length;
+}
+
+/*
+ * Gets the slopes of a heightfield on a sample, along the X and Z axes. They
+ * are taken from the samples around it.
+ *
+ * field: Heightfield where the sample is.
+ * column: Column (X) of the sample.
+ * row: Row (Z) of the sample.
+ * slope_x: Output parameter for the change of height for each unit of X.
+ * slope_z: Output parameter for the change of height for each unit of Z.
+ */
+void get_sample_slopes(const Heightfield *field, int column, int row, Real *slope_x, Real *slope_z)
+{
+    int prev_column, next_column, prev_row, next_row;
+    prev_column = column > 0 ? column - 1 : column;
+    next_column = column < field->columns - 1 ? column + 1 : column;
+    prev_row = row > 0 ? row - 1 : row;
+    next_row = row < field->rows - 1 ? row + 1 : row;
+    *slope_x = (get_sample_height(field, next_column, row) - get_sample_height(field, prev_column, row)) /
+               ((next_column - prev_column) * field->cell_x);
+    *slope_z = (get_sample_height(field, column, next_row) - get_sample_height(field, column, prev_row)) /
+               ((next_row - prev_row) * field->cell_z);
+}
+
+/*
+ * Returns the normal vector of a heightfield on a given position. The slopes
+ * of the four samples of the cell are interpolated, so the terrain looks
+ * smooth. The vector is already normalized.
+ *
+ * posn: Position at which the intersection occured
+ * field_ptr: Pointer to a heightfield figure.
+ * primitive: Cell of the heightfield where the position is.
+ */
+Vector get_heightfield_normal_vector(Vector posn, void* field_ptr, int primitive)
+{
+    Heightfield *field = (Heightfield*) field_ptr;
+    Vector normal_vector;
+    Real cell_u, cell_v, slopes_x[4], slopes_z[4];
+    int column, row;
+
+    column = primitive % (field->columns - 1);
+    row = primitive / (field->columns - 1);
+    cell_u = real_min(real_max((posn.x - field->anchor.x) / field->cell_x - column, 0.0), 1.0);
+    cell_v = real_min(real_max((posn.z - field->anchor.z) / field->cell_z - row, 0.0), 1.0);
+    get_sample_slopes(field, column, row, &slopes_x[0], &slopes_z[0]);
+    get_sample_slopes(field, column + 1, row, &slopes_x[1], &slopes_z[1]);
+    get_sample_slopes(field, column, row + 1, &slopes_x[2], &slopes_z[2]);
+    get_sample_slopes(field, column + 1, row + 1, &slopes_x[3], &slopes_z[3]);
+    normal_vector.x = - ((1 - cell_v) * ((1 - cell_u) * slopes_x[0] + cell_u * slopes_x[1]) +
+                         cell_v * ((1 - cell_u) * slopes_x[2] + cell_u * slopes_x[3]));
+    normal_vector.y = 1.0;
+    normal_vector.z = - ((1 - cell_v) * ((1 - cell_u) * slopes_z[0] + cell_u * slopes_z[1]) +
+                         cell_v * ((1 - cell_u) * slopes_z[2] + cell_u * slopes_z[3]));
+    normalize_vector(&normal_vector);
+    return normal_vector;
+}
+
+/*
+ * Calculates the box that encloses a heightfield. Heightfields are always
+ * bounded.
+ *
+ * field_ptr: Pointer to a heightfield figure.
+ * box: Output parameter for the box of the heightfield.
+ */
+int get_heightfield_bounds(void* field_ptr, BoundingBox *box)
+{
+    Heightfield *field = (Heightfield*) field_ptr;
+    box->min = (Vector){ .x = field->anchor.x, .y = field->min_height, .z = field->anchor.z };
+    box->max = (Vector){ .x = field->anchor.x + (field->columns - 1) * field->cell_x,
+                         .y = field->max_height,
+                         .z = field->anchor.z + (field->rows - 1) * field->cell_z };
+    return 1;
+}
+
+/*
+ * Frees the memory used by a heightfield.
+ *
+ * field: Heightfield that will be destroyed.
+ */
+void destroy_heightfield(Heightfield *field)
+{
+    free(field->heights);
+    free(field->level_starts);
+    free(field->level_columns);
+    free(field->pyramid);
+    free(field);
+}
@@ -0,0 +1,49 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
+
+/*
+ * Represents a terrain given by a grid of heights. The samples are spread
+ * over the X and Z axes, and each cell between four samples is drawn as two
+ * triangles. Empty space is skipped with a pyramid of blocks of cells, where
+ * each block keeps the lowest and highest height of its samples.
+ *
+ * heights: Height of each sample, already scaled and moved by the anchor. The
+ *          samples are stored by rows (Z) of 'columns' samples (X).
+ * columns: Number of samples along the X axis.
+ * rows: Number of samples along the Z axis.
+ * anchor: Position of the first sample, without its height.
+ * cell_x, cell_z: Size of a cell along the X and Z axes.
+ * min_height, max_height: Lowest and highest heights of the samples.
+ * levels: Number of levels of the pyramid. Blocks of the level 'k' have
+ *         2^k x 2^k cells, and the last level has a single block. Cells are the
+ *         level 0, which is not stored.
+ * level_starts: Position in 'pyramid' of the first block of each level.
+ * level_columns: Number of blocks of each level along the X axis.
+ * pyramid: Lowest and highest height of each block, two values per block.
+ */
+typedef struct
+{
+	float *heights;
+	int columns;
+	int rows;
+	Vector anchor;
+	Real cell_x;
+	Real cell_z;
+	Real min_height;
+	Real max_height;
+	int levels;
+	int *level_starts;
+	int *level_columns;
+	float *pyramid;
+} Heightfield;
+
+void prepare_heightfield(Heightfield *field);
+void destroy_heightfield(Heightfield *field);
+int get_heightfield_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_heightfield_normal_vector(Vector posn, void* field_ptr, int primitive);
+int get_heightfield_bounds(void* field_ptr, BoundingBox *box);
+
+#endif
@@ -0,0 +1,85 @@
+/* instance.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains all the instance object functions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/intersection.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/transform.h"
+#include "../tracing/figure.h"
+#include "instance.h"
+
+/*
+ * Finds the intersections between an instance and a ray. Returns the number of
+ * intersections found. The ray is moved to the space of the geometry, and the
+ * hits found there are moved back to the scene.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * object_ptr: Pointer to the Object struct that represents the instance.
+ * inter_list: Output list for the intersections found.
+ */
+int get_instance_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
+{
+    Object *obj = (Object*) object_ptr;
+    Instance *instance = (Instance*) obj->figure;
+    Intersection *inter_found = (Intersection*) inter_list;
+    Vector object_eye, object_dir_vec;
+    Real dir_length;
+    int inter_i, inter_amount;
+
+    object_eye = transform_point(&instance->to_object, eye);
+    object_dir_vec = transform_direction(&instance->to_object, dir_vec);
+    // Distances in the space of the geometry are scaled by the length of the direction
+    dir_length = normalize_vector(&object_dir_vec);
+    inter_amount = get_figure_intersections(object_eye, object_dir_vec, &instance->shape, inter_found);
+    for(inter_i = 0; inter_i < inter_amount; inter_i++)
+    {
+        inter_found[inter_i].distance /= dir_length;
+        inter_found[inter_i].posn = get_ray_position(eye, dir_vec, inter_found[inter_i].distance);
+        inter_found[inter_i].obj = obj;
+    }
+    return inter_amount;
+}
+
+/*
+ * Returns the normal vector of an instance on a given position. The vector is
+ * already normalized.
+ *
+ * posn: Position at which the intersection occured
+ * instance_ptr: Pointer to an instance figure.
+ * primitive: Primitive of the geometry where the position is.
+ */
+Vector get_instance_normal_vector(Vector posn, void* instance_ptr, int primitive)
+{
+    Instance *instance = (Instance*) instance_ptr;
+    Vector normal_vector;
+
+    normal_vector = get_figure_normal_vector(transform_point(&instance->to_object, posn), &instance->shape, primitive);
+    normal_vector = transform_normal(&instance->to_object, normal_vector);
+    normalize_vector(&normal_vector);
+    return normal_vector;
+}
+
+/*
+ * Calculates the box that encloses an instance. Instances are bounded only if
+ * their geometry is bounded.
+ *
+ * instance_ptr: Pointer to an instance figure.
+ * box: Output parameter for the box of the instance.
+ */
+int get_instance_bounds(void* instance_ptr, BoundingBox *box)
+{
+    Instance *instance = (Instance*) instance_ptr;
+    BoundingBox object_box;
+
+    if(!get_figure_bounds(&instance->shape, &object_box)) return 0;
+    *box = transform_box(&instance->to_world, object_box);
+    return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/transform.h"
+
+/*
+ * Represents a copy of a shared geometry placed in the scene through an affine
+ * transform. The figure of the geometry (and its hierarchy, for meshes) is not
+ * copied, the rays are moved to the space of the geometry instead.
+ *
+ * shape: Object with the figure and functions of the geometry, and the
+ *        materials of the instance (some figures look at them to know how
+ *        many hits they must search).
+ * to_world: Transform from the space of the geometry to the scene.
+ * to_object: Transform from the scene to the space of the geometry.
+ */
+typedef struct
+{
+	Object shape;
+	Transform to_world;
+	Transform to_object;
+} Instance;
+
+int get_instance_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_instance_normal_vector(Vector posn, void* instance_ptr, int primitive);
+int get_instance_bounds(void* instance_ptr, BoundingBox *box);
+
+#endif
@@ -0,0 +1,266 @@
+/* mesh.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains all the triangle mesh object functions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../utilities/memory_handler.h"
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/intersection.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/bvh.h"
+#include "mesh.h"
+
+/*
+ * Holds the values of a ray that every triangle test needs. The ray space is
+ * sheared, so the ray direction becomes the unit vector of 'axis_z'.
+ *
+ * eye: Position from which the ray is thrown.
+ * axis_x, axis_y: Axes of the ray space that are not 'axis_z'.
+ * axis_z: Axis where the ray direction is the largest.
+ * shear_x, shear_y, shear_z: Shear of the ray space.
+ */
+typedef struct
+{
+    Vector eye;
+    int axis_x;
+    int axis_y;
+    int axis_z;
+    Real shear_x;
+    Real shear_y;
+    Real shear_z;
+} TriangleRay;
+
+/*
+ * Returns the values of a ray that every triangle test needs.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ */
+TriangleRay get_triangle_ray(Vector eye, Vector dir_vec)
+{
+    TriangleRay ray;
+    ray.eye = eye;
+    if(real_abs(dir_vec.x) >= real_abs(dir_vec.y) && real_abs(dir_vec.x) >= real_abs(dir_vec.z)) ray.axis_z = 0;
+    else if(real_abs(dir_vec.y) >= real_abs(dir_vec.z)) ray.axis_z = 1;
+    else ray.axis_z = 2;
+    ray.axis_x = (ray.axis_z + 1) % 3;
+    ray.axis_y = (ray.axis_z + 2) % 3;
+    ray.shear_z = 1.0 / get_box_axis_value(dir_vec, ray.axis_z);
+    ray.shear_x = get_box_axis_value(dir_vec, ray.axis_x) * ray.shear_z;
+    ray.shear_y = get_box_axis_value(dir_vec, ray.axis_y) * ray.shear_z;
+    return ray;
+}
+
+/*
+ * Returns true if a ray hits a triangle nearer than 'max_distance', and farther
+ * than INTER_EPSILON (so a ray thrown from the mesh doesn't hit it right away).
+ * The test is watertight: a ray that goes through a border shared by two
+ * triangles always hits one of them.
+ *
+ * ray: Ray values for the triangle tests (see 'get_triangle_ray').
+ * vertex1, vertex2, vertex3: Corners of the triangle.
+ * max_distance: Distance beyond which the hits are discarded.
+ * distance: Output parameter for the distance from the eye to the hit.
+ */
+int hit_triangle(const TriangleRay *ray, Vector vertex1, Vector vertex2, Vector vertex3, Real max_distance, Real *distance)
+{
+    Vector a, b, c;
+    Real a_x, a_y, b_x, b_y, c_x, c_y, u, v, w, det;
+    // Move the corners to the ray space
+    a = subtract_vectors(vertex1, ray->eye);
+    b = subtract_vectors(vertex2, ray->eye);
+    c = subtract_vectors(vertex3, ray->eye);
+    a_x = get_box_axis_value(a, ray->axis_x) - ray->shear_x * get_box_axis_value(a, ray->axis_z);
+    a_y = get_box_axis_value(a, ray->axis_y) - ray->shear_y * get_box_axis_value(a, ray->axis_z);
+    b_x = get_box_axis_value(b, ray->axis_x) - ray->shear_x * get_box_axis_value(b, ray->axis_z);
+    b_y = get_box_axis_value(b, ray->axis_y) - ray->shear_y * get_box_axis_value(b, ray->axis_z);
+    c_x = get_box_axis_value(c, ray->axis_x) - ray->shear_x * get_box_axis_value(c, ray->axis_z);
+    c_y = get_box_axis_value(c, ray->axis_y) - ray->shear_y * get_box_axis_value(c, ray->axis_z);
+    // The ray goes through the triangle if the origin is on the same side of every border
+    u = c_x * b_y - c_y * b_x;
+    v = a_x * c_y - a_y * c_x;
+    w = b_x * a_y - b_y * a_x;
+    if((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) return 0;
+    det = u + v + w;
+    if(det == 0) return 0;
+    *distance = ray->shear_z * (u * get_box_axis_value(a, ray->axis_z) +
+                                v * get_box_axis_value(b, ray->axis_z) +
+                                w * get_box_axis_value(c, ray->axis_z)) / det;
+    return *distance > INTER_EPSILON && *distance < max_distance;
+}
+
+/*
+ * Finds the intersections between a mesh and a ray. Returns the number of
+ * intersections found. Only the nearest one is searched for opaque objects
+ * without cutting planes, otherwise the MAX_FIGURE_INTERSECTIONS nearest ones. The children of each
+ * node of the hierarchy are visited from the nearest to the farthest.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * object_ptr: Pointer to the Object struct that represents the mesh.
+ * inter_list: Output list for the intersections found.
+ */
+int get_mesh_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
+{
+    Object *obj = (Object*) object_ptr;
+    Mesh *mesh = (Mesh*) obj->figure;
+    Intersection *inter_found = (Intersection*) inter_list;
+    TriangleRay ray;
+    BvhNode *node;
+    Vector inv_dir_vec;
+    Real distance, max_distance, near_distance, left_distance, right_distance;
+    Real distances[MAX_FIGURE_INTERSECTIONS];
+    int primitives[MAX_FIGURE_INTERSECTIONS];
+    int node_stack[BVH_MAX_DEPTH + 1];
+    Real distance_stack[BVH_MAX_DEPTH + 1];
+    int *corners;
+    int max_length, length, hit_i, item_i, node_i, stack_length, left_hit, right_hit;
+
+    // The hits behind the nearest one are only seen through transparent or translucent objects,
+    // or when the nearest one is cut by a cutting plane
+    if(obj->transparency_material > 0.0 || obj->translucency_material > 0.0 || obj->cutting_planes_length > 0)
+        max_length = MAX_FIGURE_INTERSECTIONS;
+    else
+        max_length = 1;
+    length = 0;
+    max_distance = INFINITY;
+    ray = get_triangle_ray(eye, dir_vec);
+    inv_dir_vec = get_inverse_direction(dir_vec);
+    stack_length = 0;
+    if(mesh->bvh.nodes_length && is_box_hit(mesh->bvh.nodes[0].box, eye, inv_dir_vec, max_distance, &near_distance))
+    {
+        node_stack[stack_length] = 0;
+        distance_stack[stack_length++] = near_distance;
+    }
+    while(stack_length > 0)
+    {
+        node_i = node_stack[--stack_length];
+        if(distance_stack[stack_length] > max_distance) continue;
+        node = &mesh->bvh.nodes[node_i];
+        if(node->length)
+        {
+            for(item_i = node->first; item_i < node->first + node->length; item_i++)
+            {
+                corners = &mesh->triangles[3 * mesh->bvh.indexes[item_i]];
+                if(!hit_triangle(&ray, mesh->vertex[corners[0]], mesh->vertex[corners[1]], mesh->vertex[corners[2]],
+                                 max_distance, &distance))
+                {
+                    continue;
+                }
+                // Keep the hits ordered, the farthest one is dropped when the list is full
+                for(hit_i = length < max_length ? length++ : max_length - 1; hit_i > 0 && distances[hit_i - 1] > distance; hit_i--)
+                {
+                    distances[hit_i] = distances[hit_i - 1];
+                    primitives[hit_i] = primitives[hit_i - 1];
+                }
+                distances[hit_i] = distance;
+                primitives[hit_i] = mesh->bvh.indexes[item_i];
+                if(length == max_length) max_distance = distances[max_length - 1];
+            }
+            continue;
+        }
+        left_hit = is_box_hit(mesh->bvh.nodes[node_i + 1].box, eye, inv_dir_vec, max_distance, &left_distance);
+        right_hit = is_box_hit(mesh->bvh.nodes[node->right_child].box, eye, inv_dir_vec, max_distance, &right_distance);
+        // The nearest child is pushed last, so it is visited first
+        if(left_hit && right_hit && left_distance <= right_distance)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+            right_hit = 0;
+        }
+        if(left_hit)
+        {
+            node_stack[stack_length] = node_i + 1;
+            distance_stack[stack_length++] = left_distance;
+        }
+        if(right_hit)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+        }
+    }
+    for(hit_i = 0; hit_i < length; hit_i++)
+    {
+        inter_found[hit_i].posn = get_ray_position(eye, dir_vec, distances[hit_i]);
+        inter_found[hit_i].distance = distances[hit_i];
+        inter_found[hit_i].obj = obj;
+        inter_found[hit_i].is_valid = 1;
+        inter_found[hit_i].primitive = primitives[hit_i];
+    }
+    return length;
+}
+
+/*
+ * Returns the normal vector of a mesh on a given position. The vector is
+ * already normalized.
+ *
+ * posn: Position at which the intersection occured
+ * mesh_ptr: Pointer to a mesh figure.
+ * primitive: Triangle of the mesh where the position is.
+ */
+Vector get_mesh_normal_vector(Vector posn, void* mesh_ptr, int primitive)
+{
+    Mesh *mesh = (Mesh*) mesh_ptr;
+    int *corners = &mesh->triangles[3 * primitive];
+    Vector normal_vector = do_cross_product(subtract_vectors(mesh->vertex[corners[1]], mesh->vertex[corners[0]]),
+                                            subtract_vectors(mesh->vertex[corners[2]], mesh->vertex[corners[0]]));
+    normalize_vector(&normal_vector);
+    return normal_vector;
+}
+
+/*
+ * Calculates the box that encloses a mesh. Meshes with triangles are always
+ * bounded.
+ *
+ * mesh_ptr: Pointer to a mesh figure.
+ * box: Output parameter for the box of the mesh.
+ */
+int get_mesh_bounds(void* mesh_ptr, BoundingBox *box)
+{
+    Mesh *mesh = (Mesh*) mesh_ptr;
+    if(!mesh->bvh.nodes_length) return 0;
+    *box = mesh->bvh.nodes[0].box;
+    return 1;
+}
+
+/*
+ * Builds the bounding volume hierarchy over the triangles of a mesh. It must
+ * be called after the vertex and the triangles are loaded.
+ *
+ * mesh: Mesh whose hierarchy is built.
+ */
+void build_mesh_hierarchy(Mesh *mesh)
+{
+    BoundingBox *boxes;
+    int triangle_i, corner_i;
+
+    boxes = (BoundingBox*) get_memory(sizeof(BoundingBox) * (mesh->triangle_amount + 1), NULL);
+    for(triangle_i = 0; triangle_i < mesh->triangle_amount; triangle_i++)
+    {
+        boxes[triangle_i] = get_empty_box();
+        for(corner_i = 0; corner_i < 3; corner_i++)
+            boxes[triangle_i] = add_point_to_box(boxes[triangle_i], mesh->vertex[mesh->triangles[3 * triangle_i + corner_i]]);
+        // Triangles on an axis plane would have flat boxes
+        boxes[triangle_i] = expand_box(boxes[triangle_i], REAL_TOLERANCE);
+    }
+    mesh->bvh = build_bvh(boxes, mesh->triangle_amount);
+    free(boxes);
+}
+
+/*
+ * Frees the memory used by a mesh.
+ *
+ * mesh: Mesh that will be destroyed.
+ */
+void destroy_mesh(Mesh *mesh)
+{
+    destroy_bvh(&mesh->bvh);
+    free(mesh->vertex);
+    free(mesh->triangles);
+    free(mesh);
+}
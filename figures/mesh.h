@@ -0,0 +1,35 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/bvh.h"
+
+/*
+ * Represents a triangle mesh object. The triangles share their vertex, so
+ * they only store the positions of their corners in the vertex list. The
+ * normal of each triangle is the normal of its plane.
+ *
+ * vertex: List of vertex of the mesh.
+ * vertex_amount: Number of vertex of the mesh.
+ * triangles: Positions in 'vertex' of the corners of the triangles, three per
+ *            triangle.
+ * triangle_amount: Number of triangles of the mesh.
+ * bvh: Bounding volume hierarchy over the triangles. It stores triangle positions.
+ */
+typedef struct
+{
+	Vector *vertex;
+	int vertex_amount;
+	int *triangles;
+	int triangle_amount;
+	Bvh bvh;
+} Mesh;
+
+void build_mesh_hierarchy(Mesh *mesh);
+void destroy_mesh(Mesh *mesh);
+int get_mesh_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_mesh_normal_vector(Vector posn, void* mesh_ptr, int primitive);
+int get_mesh_bounds(void* mesh_ptr, BoundingBox *box);
+
+#endif
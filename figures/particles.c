@@ -0,0 +1,215 @@
+/* particles.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains all the particle cloud object functions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../utilities/memory_handler.h"
+#include "../utilities/file_mapping.h"
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/intersection.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/bvh.h"
+#include "particles.h"
+
+/*
+ * Returns the center of a particle.
+ *
+ * cloud: Cloud where the particle is.
+ * particle_i: Position of the particle in the cloud.
+ */
+Vector get_particle_center(const ParticleCloud *cloud, int particle_i)
+{
+    return (Vector){ .x = cloud->center_x[particle_i], .y = cloud->center_y[particle_i], .z = cloud->center_z[particle_i] };
+}
+
+/*
+ * Finds the intersections between a cloud of particles and a ray. Returns the
+ * number of intersections found. Only the nearest one is searched for opaque
+ * objects without cutting planes, otherwise the MAX_FIGURE_INTERSECTIONS
+ * nearest ones. The children of each node of the hierarchy are visited from
+ * the nearest to the farthest.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * object_ptr: Pointer to the Object struct that represents the cloud.
+ * inter_list: Output list for the intersections found.
+ */
+int get_particles_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
+{
+    Object *obj = (Object*) object_ptr;
+    ParticleCloud *cloud = (ParticleCloud*) obj->figure;
+    Intersection *inter_found = (Intersection*) inter_list;
+    BvhNode *node;
+    Vector inv_dir_vec, center_diff;
+    Real max_distance, near_distance, left_distance, right_distance, b, c, discriminant, root;
+    Real distances[MAX_FIGURE_INTERSECTIONS], particle_distances[2];
+    int primitives[MAX_FIGURE_INTERSECTIONS];
+    int node_stack[BVH_MAX_DEPTH + 1];
+    Real distance_stack[BVH_MAX_DEPTH + 1];
+    int max_length, length, hit_i, item_i, node_i, particle_i, side_i, stack_length, left_hit, right_hit;
+
+    if(obj->transparency_material > 0.0 || obj->translucency_material > 0.0 || obj->cutting_planes_length > 0)
+        max_length = MAX_FIGURE_INTERSECTIONS;
+    else
+        max_length = 1;
+    length = 0;
+    max_distance = INFINITY;
+    inv_dir_vec = get_inverse_direction(dir_vec);
+    stack_length = 0;
+    if(cloud->bvh.nodes_length && is_box_hit(cloud->bvh.nodes[0].box, eye, inv_dir_vec, max_distance, &near_distance))
+    {
+        node_stack[stack_length] = 0;
+        distance_stack[stack_length++] = near_distance;
+    }
+    while(stack_length > 0)
+    {
+        node_i = node_stack[--stack_length];
+        if(distance_stack[stack_length] > max_distance) continue;
+        node = &cloud->bvh.nodes[node_i];
+        if(node->length)
+        {
+            for(item_i = node->first; item_i < node->first + node->length; item_i++)
+            {
+                particle_i = cloud->bvh.indexes[item_i];
+                // The direction is normalized, so the quadratic is t^2 + 2bt + c
+                center_diff = subtract_vectors(eye, get_particle_center(cloud, particle_i));
+                b = do_dot_product(dir_vec, center_diff);
+                c = do_dot_product(center_diff, center_diff) - (Real) cloud->radius[particle_i] * cloud->radius[particle_i];
+                discriminant = b * b - c;
+                if(discriminant < 0) continue;
+                root = real_sqrt(discriminant);
+                particle_distances[0] = - b - root;
+                particle_distances[1] = - b + root;
+                for(side_i = 0; side_i < 2; side_i++)
+                {
+                    if(particle_distances[side_i] <= INTER_EPSILON || particle_distances[side_i] >= max_distance) continue;
+                    // Keep the hits ordered, the farthest one is dropped when the list is full
+                    for(hit_i = length < max_length ? length++ : max_length - 1;
+                        hit_i > 0 && distances[hit_i - 1] > particle_distances[side_i]; hit_i--)
+                    {
+                        distances[hit_i] = distances[hit_i - 1];
+                        primitives[hit_i] = primitives[hit_i - 1];
+                    }
+                    distances[hit_i] = particle_distances[side_i];
+                    primitives[hit_i] = particle_i;
+                    if(length == max_length) max_distance = distances[max_length - 1];
+                }
+            }
+            continue;
+        }
+        left_hit = is_box_hit(cloud->bvh.nodes[node_i + 1].box, eye, inv_dir_vec, max_distance, &left_distance);
+        right_hit = is_box_hit(cloud->bvh.nodes[node->right_child].box, eye, inv_dir_vec, max_distance, &right_distance);
+        // The nearest child is pushed last, so it is visited first
+        if(left_hit && right_hit && left_distance <= right_distance)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+            right_hit = 0;
+        }
+        if(left_hit)
+        {
+            node_stack[stack_length] = node_i + 1;
+            distance_stack[stack_length++] = left_distance;
+        }
+        if(right_hit)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+        }
+    }
+    for(hit_i = 0; hit_i < length; hit_i++)
+    {
+        inter_found[hit_i].posn = get_ray_position(eye, dir_vec, distances[hit_i]);
+        inter_found[hit_i].distance = distances[hit_i];
+        inter_found[hit_i].obj = obj;
+        inter_found[hit_i].is_valid = 1;
+        inter_found[hit_i].primitive = primitives[hit_i];
+    }
+    return length;
+}
+
+/*
+ * Returns the normal vector of a cloud of particles on a given position. The
+ * vector is already normalized.
+ *
+ * posn: Position at which the intersection occured
+ * cloud_ptr: Pointer to a particle cloud figure.
+ * primitive: Particle of the cloud where the position is.
+ */
+Vector get_particles_normal_vector(Vector posn, void* cloud_ptr, int primitive)
+{
+    ParticleCloud *cloud = (ParticleCloud*) cloud_ptr;
+    return multiply_vector(1.0 / cloud->radius[primitive], subtract_vectors(posn, get_particle_center(cloud, primitive)));
+}
+
+/*
+ * Calculates the box that encloses a cloud of particles. Clouds with particles
+ * are always bounded.
+ *
+ * cloud_ptr: Pointer to a particle cloud figure.
+ * box: Output parameter for the box of the cloud.
+ */
+int get_particles_bounds(void* cloud_ptr, BoundingBox *box)
+{
+    ParticleCloud *cloud = (ParticleCloud*) cloud_ptr;
+    if(!cloud->bvh.nodes_length) return 0;
+    *box = cloud->bvh.nodes[0].box;
+    return 1;
+}
+
+/*
+ * Returns the color of a particle. Clouds without colors use the color of
+ * their object.
+ *
+ * cloud: Cloud where the particle is.
+ * primitive: Position of the particle in the cloud.
+ * obj_color: Color of the object of the cloud.
+ */
+Color get_particle_color(ParticleCloud *cloud, int primitive, Color obj_color)
+{
+    const unsigned char *color;
+    if(!cloud->colors) return obj_color;
+    color = &cloud->colors[3 * primitive];
+    return (Color){ .red = color[0] / 255.0, .green = color[1] / 255.0, .blue = color[2] / 255.0 };
+}
+
+/*
+ * Builds the bounding volume hierarchy over the particles of a cloud. It must
+ * be called after the particles are loaded.
+ *
+ * cloud: Cloud whose hierarchy is built.
+ */
+void build_particles_hierarchy(ParticleCloud *cloud)
+{
+    BoundingBox *boxes;
+    Vector center, radius_vec;
+    int particle_i;
+
+    boxes = (BoundingBox*) get_memory(sizeof(BoundingBox) * (cloud->particle_amount + 1), NULL);
+    for(particle_i = 0; particle_i < cloud->particle_amount; particle_i++)
+    {
+        center = get_particle_center(cloud, particle_i);
+        radius_vec = (Vector){ .x = cloud->radius[particle_i], .y = cloud->radius[particle_i], .z = cloud->radius[particle_i] };
+        boxes[particle_i].min = subtract_vectors(center, radius_vec);
+        boxes[particle_i].max = get_ray_position(center, radius_vec, 1);
+    }
+    cloud->bvh = build_bvh(boxes, cloud->particle_amount);
+    free(boxes);
+}
+
+/*
+ * Frees the memory used by a particle cloud, and unmaps its particle file.
+ *
+ * cloud: Cloud that will be destroyed.
+ */
+void destroy_particles(ParticleCloud *cloud)
+{
+    destroy_bvh(&cloud->bvh);
+    if(cloud->mapping) unmap_file(cloud->mapping, cloud->mapping_size);
+    free(cloud);
+}
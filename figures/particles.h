@@ -0,0 +1,45 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stddef.h>
+
+#include "../tracing/vector.h"
+#include "../tracing/color.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/bvh.h"
+
+/*
+ * Represents a cloud of small spheres (particles) that share the materials of
+ * their object. The particles are stored by attribute (a list for each one),
+ * usually pointing into a mapped particle file (see particle_loader.c).
+ *
+ * center_x, center_y, center_z: Coordinates of the center of each particle.
+ * radius: Radius of each particle.
+ * colors: Red, green and blue values (0 to 255) of each particle, three per
+ *         particle. It is NULL if the particles use the color of the object.
+ * particle_amount: Number of particles of the cloud.
+ * mapping: Mapped particle file that holds the particles. It is NULL if they are not in a mapped file.
+ * mapping_size: Number of bytes of the mapped particle file.
+ * bvh: Bounding volume hierarchy over the particles. It stores particle positions.
+ */
+typedef struct
+{
+	const float *center_x;
+	const float *center_y;
+	const float *center_z;
+	const float *radius;
+	const unsigned char *colors;
+	int particle_amount;
+	const void *mapping;
+	size_t mapping_size;
+	Bvh bvh;
+} ParticleCloud;
+
+void build_particles_hierarchy(ParticleCloud *cloud);
+void destroy_particles(ParticleCloud *cloud);
+int get_particles_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_particles_normal_vector(Vector posn, void* cloud_ptr, int primitive);
+int get_particles_bounds(void* cloud_ptr, BoundingBox *box);
+Color get_particle_color(ParticleCloud *cloud, int primitive, Color obj_color);
+
+#endif
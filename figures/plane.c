@@ -29,24 +29,28 @@ int is_up_the_plane(Vector posn, Plane plane)
 }
 
 /*
- * Returns a pointer to the intersection between a plane and a ray.
+ * Finds the intersection between the given plane and a ray. Returns true if
+ * the ray hits the plane. Figures that are drawn over a plane (polygons,
+ * discs) use it to get their plane intersection without swapping the figure
+ * of the object, so the object is never modified and several threads can
+ * trace it at once.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized
- * object_ptr: Pointer to the Object struct that represents the plane
- * length: Output parameter for the number of intersections found.
+ * plane_ptr: Pointer to the plane with which the intersection is calculated.
+ * object_ptr: Pointer to the Object struct that owns the plane.
+ * inter_ptr: Output parameter for the intersection (Intersection struct).
  */
-void* get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_embedded_plane_intersection(Vector eye, Vector dir_vec, Plane *plane_ptr, void* object_ptr, void* inter_ptr)
 {
-	Plane* plane_ptr =  (Plane*) ((Object*)object_ptr)->figure;
+	Intersection* inter_found = (Intersection*) inter_ptr;
 	// We check the direction vector isn't paralell to the plane
-	long double dir_factor =    plane_ptr->direction.x * dir_vec.x +
+	Real dir_factor =    plane_ptr->direction.x * dir_vec.x +
                                 plane_ptr->direction.y * dir_vec.y +
                                 plane_ptr->direction.z * dir_vec.z;
 	if(dir_factor)
 	{
-		// We calculate the intersection with the plane and return it
-		Intersection* inter_found = get_memory(sizeof(Intersection), NULL);
+		// We calculate the intersection with the plane
 		inter_found->distance = - ( plane_ptr->direction.x * eye.x +
                                     plane_ptr->direction.y * eye.y +
                                     plane_ptr->direction.z * eye.z +
@@ -54,18 +58,28 @@ void* get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *
 		if(inter_found->distance > 0)
 		{
 			inter_found->posn = get_ray_position(eye, dir_vec, inter_found->distance);
-			inter_found->obj = *((Object*)object_ptr);
+			inter_found->obj = (Object*) object_ptr;
 			inter_found->is_valid = 1;
-			if(length) *length = 1;
-			return inter_found;
-		}
-		else
-		{
-			free(inter_found);
-			return NULL;
+			inter_found->primitive = 0;
+			return 1;
 		}
 	}
-	else return NULL;
+	return 0;
+}
+
+/*
+ * Finds the intersection between a plane and a ray. Returns the number of
+ * intersections found.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized
+ * object_ptr: Pointer to the Object struct that represents the plane
+ * inter_list: Output list for the intersections found.
+ */
+int get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
+{
+	Plane* plane_ptr =  (Plane*) ((Object*)object_ptr)->figure;
+	return get_embedded_plane_intersection(eye, dir_vec, plane_ptr, object_ptr, inter_list);
 }
 
 /*
@@ -74,9 +88,81 @@ void* get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *
  *
  * posn: Position at which the intersection occured
  * polygon_ptr: Pointer to a plane figure.
+ * primitive: Unused, planes are a single surface.
  */
-Vector get_plane_normal_vector(Vector posn, void* plane_ptr)
+Vector get_plane_normal_vector(Vector posn, void* plane_ptr, int primitive)
 {
 	Plane plane = *((Plane*) plane_ptr);
 	return plane.direction;
 }
+
+/*
+ * Planes are infinite, so they can't be enclosed by a box. It always returns
+ * false, and the plane is tested against every ray.
+ *
+ * plane_ptr: Pointer to a plane figure.
+ * box: Output parameter for the box of the plane. It is not modified.
+ */
+int get_plane_bounds(void* plane_ptr, BoundingBox *box)
+{
+	return 0;
+}
+
+/*
+ * Returns the smallest box that contains the part of a box that is not cut by
+ * a list of cutting planes (the part below all of them). If the whole box is
+ * cut, the returned box is empty. The corners of the part that is not cut are
+ * found where three of the planes or the box faces meet, so it is only meant
+ * for the few cutting planes of an object.
+ *
+ * box: Box that is clipped.
+ * planes: Cutting planes.
+ * planes_length: Number of cutting planes.
+ */
+BoundingBox clip_box_by_planes(BoundingBox box, const Plane *planes, int planes_length)
+{
+    Plane limits[6 + planes_length];
+    BoundingBox clipped_box;
+    Vector corner, cross_jk, cross_ki, cross_ij;
+    Real det;
+    int limits_length, limit_i, limit_j, limit_k, check_i;
+
+    if(!planes_length) return box;
+    // The box faces, looking outside of the box
+    limits[0] = (Plane){ .direction = { .x = 1.0, .y = 0.0, .z = 0.0 }, .offset = - box.max.x };
+    limits[1] = (Plane){ .direction = { .x = -1.0, .y = 0.0, .z = 0.0 }, .offset = box.min.x };
+    limits[2] = (Plane){ .direction = { .x = 0.0, .y = 1.0, .z = 0.0 }, .offset = - box.max.y };
+    limits[3] = (Plane){ .direction = { .x = 0.0, .y = -1.0, .z = 0.0 }, .offset = box.min.y };
+    limits[4] = (Plane){ .direction = { .x = 0.0, .y = 0.0, .z = 1.0 }, .offset = - box.max.z };
+    limits[5] = (Plane){ .direction = { .x = 0.0, .y = 0.0, .z = -1.0 }, .offset = box.min.z };
+    for(limits_length = 6; limits_length < 6 + planes_length; limits_length++)
+        limits[limits_length] = planes[limits_length - 6];
+    clipped_box = get_empty_box();
+    for(limit_i = 0; limit_i < limits_length; limit_i++)
+    for(limit_j = limit_i + 1; limit_j < limits_length; limit_j++)
+    for(limit_k = limit_j + 1; limit_k < limits_length; limit_k++)
+    {
+        cross_jk = do_cross_product(limits[limit_j].direction, limits[limit_k].direction);
+        det = do_dot_product(limits[limit_i].direction, cross_jk);
+        if(real_abs(det) < REAL_TOLERANCE) continue;
+        cross_ki = do_cross_product(limits[limit_k].direction, limits[limit_i].direction);
+        cross_ij = do_cross_product(limits[limit_i].direction, limits[limit_j].direction);
+        corner = multiply_vector(- limits[limit_i].offset / det, cross_jk);
+        corner = subtract_vectors(corner, multiply_vector(limits[limit_j].offset / det, cross_ki));
+        corner = subtract_vectors(corner, multiply_vector(limits[limit_k].offset / det, cross_ij));
+        for(check_i = 0; check_i < limits_length; check_i++)
+        {
+            if(do_dot_product(limits[check_i].direction, corner) + limits[check_i].offset > REAL_TOLERANCE) break;
+        }
+        if(check_i == limits_length) clipped_box = add_point_to_box(clipped_box, corner);
+    }
+    if(is_box_empty(clipped_box)) return clipped_box;
+    // The tolerance must not make the box grow
+    clipped_box.min = (Vector){ .x = real_max(clipped_box.min.x, box.min.x),
+                                .y = real_max(clipped_box.min.y, box.min.y),
+                                .z = real_max(clipped_box.min.z, box.min.z) };
+    clipped_box.max = (Vector){ .x = real_min(clipped_box.max.x, box.max.x),
+                                .y = real_min(clipped_box.max.y, box.max.y),
+                                .z = real_min(clipped_box.max.z, box.max.z) };
+    return clipped_box;
+}
@@ -2,6 +2,7 @@
 #define PLANE_H
 
 #include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
 
 /*
  * Represents a plane object
@@ -13,11 +14,14 @@
 typedef struct
 {
 	Vector direction;
-	long double offset;
+	Real offset;
 } Plane;
 
 int is_up_the_plane(Vector posn, Plane plane);
-void* get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_plane_normal_vector(Vector posn, void* plane_ptr);
+int get_embedded_plane_intersection(Vector eye, Vector dir_vec, Plane *plane_ptr, void* object_ptr, void* inter_ptr);
+int get_plane_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_plane_normal_vector(Vector posn, void* plane_ptr, int primitive);
+int get_plane_bounds(void* plane_ptr, BoundingBox *box);
+BoundingBox clip_box_by_planes(BoundingBox box, const Plane *planes, int planes_length);
 
 #endif
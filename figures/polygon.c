@@ -41,6 +41,38 @@ Coord2D transform_3d_to_2d(Vector point, Axis discarded_axis)
 	return vertex;
 }
 
+/*
+ * Transforms a 2D coordinate of a polygon back to the 3D point of the
+ * polygon's plane from which it was projected.
+ *
+ * point: 2D coordinate that is transformed.
+ * plane: Plane on which the 2D coordinate was projected.
+ */
+Vector transform_2d_to_3d(Coord2D point, Plane plane)
+{
+	Vector vertex;
+	Vector dir = plane.direction;
+	switch(get_discarded_axis(plane))
+	{
+		case X_AXIS:
+			vertex.z = point.u;
+			vertex.y = point.v;
+			vertex.x = - (plane.offset + dir.y * vertex.y + dir.z * vertex.z) / dir.x;
+			break;
+		case Y_AXIS:
+			vertex.x = point.u;
+			vertex.z = point.v;
+			vertex.y = - (plane.offset + dir.x * vertex.x + dir.z * vertex.z) / dir.y;
+			break;
+		default:
+			vertex.x = point.u;
+			vertex.y = point.v;
+			vertex.z = - (plane.offset + dir.x * vertex.x + dir.y * vertex.y) / dir.z;
+			break;
+	}
+	return vertex;
+}
+
 /*
  * Returns the axis that should be discarded if the plane were to exist in only
  * 2 dimensions. For example, the plane could be in any of these combinations:
@@ -52,8 +84,8 @@ Axis get_discarded_axis(Plane plane)
 {
     Vector dir = plane.direction;
 	// We discard the coordinate with the highest absolute value.
-	if(fabsl(dir.x) >= fabsl(dir.y) && fabsl(dir.x) >= fabsl(dir.z)) return X_AXIS;
-	else if (fabsl(dir.y) >= fabsl(dir.z)) return Y_AXIS;
+	if(real_abs(dir.x) >= real_abs(dir.y) && real_abs(dir.x) >= real_abs(dir.z)) return X_AXIS;
+	else if (real_abs(dir.y) >= real_abs(dir.z)) return Y_AXIS;
 	else return Z_AXIS;
 }
 
@@ -99,7 +131,7 @@ int is_border_valid(Coord2D border_beg, Coord2D border_end, Coord2D origin)
     }
 	else
 	{   // And check for the complex ones
-		long double x, m, b;
+		Real x, m, b;
 		m = (border_end.v - border_beg.v) / (border_end.u - border_beg.u);
 		b = border_end.v - m * border_end.u;
 		x = -b / m;
@@ -111,61 +143,304 @@ int is_border_valid(Coord2D border_beg, Coord2D border_end, Coord2D origin)
 }
 
 /*
- * Returns true if a given 3D point is contained within a polygon.
+ * Returns the number of borders of a polygon that intersect with the
+ * horizontal line drawn from 'point' to the right. Every border is checked.
  *
- * polygon: Polygon in which we check whether the given point is contained.
- * point_3d: 3D point that we wish to know if belongs to the given polygon.
+ * polygon: Polygon whose borders are checked.
+ * point: 2D coordinate from which the line is drawn.
  */
-int is_point_contained (Polygon polygon, Vector point_3d)
+int count_valid_borders(const Polygon *polygon, Coord2D point)
 {
-	// We transform the point to a 2D coordinate
-	Coord2D point = transform_3d_to_2d(point_3d, get_discarded_axis(polygon.plane));
 	Coord2D previous;
-	Coord2D next = polygon.vertex[polygon.vertex_amount - 1];
+	Coord2D next = polygon->vertex[polygon->vertex_amount - 1];
 
 	int border_counter = 0;
 	int vertex_index;
 	// We count the number of vertixes that intersect with a horizontal
 	// line drawn to the right from the 'point'
-	for(vertex_index = 0; vertex_index < polygon.vertex_amount; vertex_index++)
+	for(vertex_index = 0; vertex_index < polygon->vertex_amount; vertex_index++)
 	{
 		previous = next;
-		next = polygon.vertex[vertex_index];
+		next = polygon->vertex[vertex_index];
 		// We only sum up the borders that intersect
 		border_counter += is_border_valid(previous, next, point);
 	}
+	return border_counter;
+}
+
+/*
+ * Returns the u coordinate of a border at a given v coordinate.
+ *
+ * edge: Border of the polygon.
+ * v: Vertical coordinate.
+ */
+Real get_edge_u(PolygonEdge edge, Real v)
+{
+	return edge.beg.u + (v - edge.beg.v) * edge.u_slope;
+}
+
+/*
+ * Returns the slab of a polygon that contains a given v coordinate, which
+ * must be between the lowest and the highest v of the polygon. The slab
+ * of a vertex v is the one that begins at it ('slab_amount' for the highest).
+ *
+ * polygon: Polygon whose slabs are searched.
+ * v: Vertical coordinate.
+ */
+int find_slab(const Polygon *polygon, Real v)
+{
+	int beg = 0, end = polygon->slab_amount + 1, middle;
+	// Search the last slab that begins before or at 'v'
+	while(end - beg > 1)
+	{
+		middle = (beg + end) / 2;
+		if(polygon->slab_v[middle] <= v) beg = middle;
+		else end = middle;
+	}
+	return beg;
+}
+
+/*
+ * Returns the number of borders of a slab that are at the right of a point,
+ * or on it. The point must be strictly inside the slab.
+ *
+ * polygon: Polygon to which the slab belongs.
+ * slab_i: Slab that contains the point.
+ * point: 2D coordinate that is checked.
+ */
+int count_slab_borders(const Polygon *polygon, int slab_i, Coord2D point)
+{
+	int beg = polygon->slab_starts[slab_i], end = polygon->slab_starts[slab_i + 1];
+	int edge_i, middle, border_counter;
+	if(!polygon->slab_sorted[slab_i])
+	{
+		border_counter = 0;
+		for(edge_i = beg; edge_i < end; edge_i++)
+			border_counter += get_edge_u(polygon->slab_edges[edge_i], point.v) >= point.u;
+		return border_counter;
+	}
+	// The borders are ordered from left to right, search the first one at the right
+	border_counter = end;
+	while(beg < end)
+	{
+		middle = (beg + end) / 2;
+		if(get_edge_u(polygon->slab_edges[middle], point.v) >= point.u) end = middle;
+		else beg = middle + 1;
+	}
+	return border_counter - beg;
+}
+
+/*
+ * Returns true if a given 3D point is contained within a polygon. Points
+ * outside the box of the polygon are discarded right away. Otherwise only the
+ * borders of the slab that contains the point are checked.
+ *
+ * polygon: Polygon in which we check whether the given point is contained.
+ * point_3d: 3D point that we wish to know if belongs to the given polygon.
+ */
+int is_point_contained (const Polygon *polygon, Vector point_3d)
+{
+	int slab_i, border_counter;
+	// We transform the point to a 2D coordinate
+	Coord2D point = transform_3d_to_2d(point_3d, polygon->discarded_axis);
+	if(point.v <= polygon->box_min.v || point.v >= polygon->box_max.v ||
+	   point.u < polygon->box_min.u || point.u > polygon->box_max.u)
+	{
+		return 0;
+	}
+	slab_i = find_slab(polygon, point.v);
+	// Points at the height of a vertex are checked against every border
+	if(point.v == polygon->slab_v[slab_i]) border_counter = count_valid_borders(polygon, point);
+	else border_counter = count_slab_borders(polygon, slab_i, point);
 	// If the number of borders is odd, the point is contained
 	return border_counter % 2 == 1;
 }
 
 /*
- * Returns a pointer to the intersection between a polygon and a ray.
+ * Orders the borders of a slab from left to right by their u coordinate at
+ * the middle of the slab, and returns true if they keep that order on the
+ * whole slab (they don't cross each other).
+ *
+ * edges: Borders of the slab.
+ * edges_length: Number of borders.
+ * slab_beg: Lowest v of the slab.
+ * slab_end: Highest v of the slab.
+ */
+int sort_slab_edges(PolygonEdge *edges, int edges_length, Real slab_beg, Real slab_end)
+{
+	PolygonEdge edge;
+	Real slab_middle = (slab_beg + slab_end) / 2.0;
+	int edge_i, prev_i;
+	// Slabs have few borders, so they are sorted by insertion
+	for(edge_i = 1; edge_i < edges_length; edge_i++)
+	{
+		edge = edges[edge_i];
+		for(prev_i = edge_i; prev_i > 0 && get_edge_u(edges[prev_i - 1], slab_middle) > get_edge_u(edge, slab_middle); prev_i--)
+			edges[prev_i] = edges[prev_i - 1];
+		edges[prev_i] = edge;
+	}
+	for(edge_i = 1; edge_i < edges_length; edge_i++)
+	{
+		if(get_edge_u(edges[edge_i - 1], slab_beg) > get_edge_u(edges[edge_i], slab_beg) ||
+		   get_edge_u(edges[edge_i - 1], slab_end) > get_edge_u(edges[edge_i], slab_end))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Calculates the box, the border equations and the slabs of a polygon. It
+ * must be called after the vertex are projected to 2D.
+ *
+ * polygon: Polygon that is prepared.
+ */
+void prepare_polygon(Polygon *polygon)
+{
+	PolygonEdge edge;
+	Coord2D previous, next;
+	Real v;
+	int vertex_index, sorted_i, slab_i, last_slab_i, prev_i;
+	int *slab_fill;
+
+	// Box of the vertex, and their v coordinates ordered without repeating them
+	polygon->box_min = polygon->box_max = polygon->vertex[0];
+	polygon->slab_v = (Real*) get_memory(sizeof(Real) * polygon->vertex_amount, NULL);
+	polygon->slab_amount = 0;
+	for(vertex_index = 0; vertex_index < polygon->vertex_amount; vertex_index++)
+	{
+		next = polygon->vertex[vertex_index];
+		polygon->box_min.u = real_min(polygon->box_min.u, next.u);
+		polygon->box_min.v = real_min(polygon->box_min.v, next.v);
+		polygon->box_max.u = real_max(polygon->box_max.u, next.u);
+		polygon->box_max.v = real_max(polygon->box_max.v, next.v);
+		for(sorted_i = 0; sorted_i < polygon->slab_amount && polygon->slab_v[sorted_i] < next.v; sorted_i++);
+		if(sorted_i < polygon->slab_amount && polygon->slab_v[sorted_i] == next.v) continue;
+		for(prev_i = polygon->slab_amount++; prev_i > sorted_i; prev_i--)
+			polygon->slab_v[prev_i] = polygon->slab_v[prev_i - 1];
+		polygon->slab_v[sorted_i] = next.v;
+	}
+	// There is one slab between each pair of consecutive v coordinates
+	polygon->slab_amount--;
+	polygon->slab_starts = (int*) get_memory(sizeof(int) * (polygon->slab_amount + 1), NULL);
+	polygon->slab_sorted = (int*) get_memory(sizeof(int) * (polygon->slab_amount + 1), NULL);
+	slab_fill = (int*) get_memory(sizeof(int) * (polygon->slab_amount + 1), NULL);
+	for(slab_i = 0; slab_i <= polygon->slab_amount; slab_i++)
+		polygon->slab_starts[slab_i] = slab_fill[slab_i] = 0;
+	// Count the borders of each slab. Horizontal borders don't cross any slab.
+	next = polygon->vertex[polygon->vertex_amount - 1];
+	for(vertex_index = 0; vertex_index < polygon->vertex_amount; vertex_index++)
+	{
+		previous = next;
+		next = polygon->vertex[vertex_index];
+		if(previous.v == next.v) continue;
+		last_slab_i = find_slab(polygon, real_max(previous.v, next.v));
+		for(slab_i = find_slab(polygon, real_min(previous.v, next.v)); slab_i < last_slab_i; slab_i++)
+			polygon->slab_starts[slab_i + 1]++;
+	}
+	for(slab_i = 0; slab_i < polygon->slab_amount; slab_i++)
+		polygon->slab_starts[slab_i + 1] += polygon->slab_starts[slab_i];
+	polygon->slab_edges = (PolygonEdge*) get_memory(sizeof(PolygonEdge) * (polygon->slab_starts[polygon->slab_amount] + 1), NULL);
+	// Store the border equations on each slab that they cross
+	next = polygon->vertex[polygon->vertex_amount - 1];
+	for(vertex_index = 0; vertex_index < polygon->vertex_amount; vertex_index++)
+	{
+		previous = next;
+		next = polygon->vertex[vertex_index];
+		if(previous.v == next.v) continue;
+		edge.beg = previous.v < next.v ? previous : next;
+		v = previous.v < next.v ? next.v : previous.v;
+		edge.u_slope = ((previous.v < next.v ? next.u : previous.u) - edge.beg.u) / (v - edge.beg.v);
+		last_slab_i = find_slab(polygon, v);
+		for(slab_i = find_slab(polygon, edge.beg.v); slab_i < last_slab_i; slab_i++)
+			polygon->slab_edges[polygon->slab_starts[slab_i] + slab_fill[slab_i]++] = edge;
+	}
+	for(slab_i = 0; slab_i < polygon->slab_amount; slab_i++)
+	{
+		polygon->slab_sorted[slab_i] = sort_slab_edges(&polygon->slab_edges[polygon->slab_starts[slab_i]],
+		                                               slab_fill[slab_i],
+		                                               polygon->slab_v[slab_i],
+		                                               polygon->slab_v[slab_i + 1]);
+	}
+	free(slab_fill);
+}
+
+/*
+ * Frees the lists built by 'prepare_polygon'.
+ *
+ * polygon: Polygon whose slabs are freed.
+ */
+void free_polygon_slabs(Polygon *polygon)
+{
+	free(polygon->slab_v);
+	free(polygon->slab_starts);
+	free(polygon->slab_sorted);
+	free(polygon->slab_edges);
+}
+
+/*
+ * Frees a polygon and its lists.
+ *
+ * polygon: Polygon that is freed.
+ */
+void destroy_polygon(Polygon *polygon)
+{
+	free_polygon_slabs(polygon);
+	free(polygon->vertex);
+	free(polygon);
+}
+
+/*
+ * Adds the vertex of another polygon on the same plane as a second contour.
+ * Both contours are joined by a border that is walked twice (there and back),
+ * so it never changes whether a point is contained. The contours must not
+ * overlap, otherwise their common area would be left out. The polygon is
+ * prepared again.
+ *
+ * polygon: Polygon that receives the contour.
+ * other: Polygon whose vertex are added. It is not modified.
+ */
+void add_polygon_contour(Polygon *polygon, const Polygon *other)
+{
+	Coord2D *vertex;
+	int vertex_index, vertex_amount;
+
+	vertex_amount = polygon->vertex_amount + other->vertex_amount + 2;
+	vertex = (Coord2D*) get_memory(sizeof(Coord2D) * vertex_amount, NULL);
+	for(vertex_index = 0; vertex_index < polygon->vertex_amount; vertex_index++)
+		vertex[vertex_index] = polygon->vertex[vertex_index];
+	// Close the first contour, and come back to it after the second one
+	vertex[polygon->vertex_amount] = polygon->vertex[0];
+	for(vertex_index = 0; vertex_index < other->vertex_amount; vertex_index++)
+		vertex[polygon->vertex_amount + 1 + vertex_index] = other->vertex[vertex_index];
+	vertex[vertex_amount - 1] = other->vertex[0];
+	free(polygon->vertex);
+	free_polygon_slabs(polygon);
+	polygon->vertex = vertex;
+	polygon->vertex_amount = vertex_amount;
+	prepare_polygon(polygon);
+}
+
+/*
+ * Finds the intersection between a polygon and a ray. Returns the number of
+ * intersections found.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized
  * object_ptr: Pointer to the Object struct that represents the polygon
- * length: Output parameter for the number of intersections found.
+ * inter_list: Output list for the intersections found.
  */
-void* get_polygon_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_polygon_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
 {
 	Polygon* polygon_ptr =  (Polygon*) ((Object*)object_ptr)->figure;
+	Intersection* inter = (Intersection*) inter_list;
 	// We get the polygon's plane intersection
-	((Object*)object_ptr)->figure = &(polygon_ptr->plane);
-	Intersection* inter = get_plane_intersection(eye, dir_vec, object_ptr, NULL);
-	((Object*)object_ptr)->figure = polygon_ptr;
-	if(inter)
+	if(get_embedded_plane_intersection(eye, dir_vec, &(polygon_ptr->plane), object_ptr, inter))
     {
-        if(is_point_contained(*polygon_ptr, inter->posn))
-        {
-            *length = 1;
-            return inter;
-        }
-		else
-		{
-		    free(inter);
-		}
+        return is_point_contained(polygon_ptr, inter->posn);
     }
-	return NULL;
+	return 0;
 }
 
 /*
@@ -174,8 +449,25 @@ void* get_polygon_intersection(Vector eye, Vector dir_vec, void* object_ptr, int
  *
  * posn: Position at which the intersection occured
  * polygon_ptr: Pointer to a polygon figure.
+ * primitive: Unused, polygons are a single surface.
  */
-Vector get_polygon_normal_vector(Vector posn, void* polygon_ptr)
+Vector get_polygon_normal_vector(Vector posn, void* polygon_ptr, int primitive)
 {
-	return get_plane_normal_vector(posn, &((Polygon*) polygon_ptr)->plane);
+	return get_plane_normal_vector(posn, &((Polygon*) polygon_ptr)->plane, primitive);
+}
+
+/*
+ * Calculates the box that encloses a polygon. Polygons are always bounded.
+ *
+ * polygon_ptr: Pointer to a polygon figure.
+ * box: Output parameter for the box of the polygon.
+ */
+int get_polygon_bounds(void* polygon_ptr, BoundingBox *box)
+{
+	Polygon polygon = *((Polygon*) polygon_ptr);
+	int vertex_index;
+	*box = get_empty_box();
+	for(vertex_index = 0; vertex_index < polygon.vertex_amount; vertex_index++)
+		*box = add_point_to_box(*box, transform_2d_to_3d(polygon.vertex[vertex_index], polygon.plane));
+	return 1;
 }
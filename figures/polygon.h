@@ -2,28 +2,68 @@
 #define POLYGON_H
 
 #include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
 #include "plane.h"
 #include "coord_2d.h"
 
+typedef enum { X_AXIS, Y_AXIS, Z_AXIS} Axis;
+
+/*
+ * Represents a border of a polygon by the equation of its line on the 2D
+ * plane: u = beg.u + (v - beg.v) * u_slope
+ *
+ * beg: Vertex of the border with the lowest v.
+ * u_slope: Change of u for each unit of v.
+ */
+typedef struct
+{
+	Coord2D beg;
+	Real u_slope;
+} PolygonEdge;
+
 /*
  * Represents a polygon object
  *
  * plane: Plane in which the polygon is drawn.
  * vertex_amount: Number of vertex that the polygon has.
- * vertex: List of vertex that enclose the polygon.
+ * vertex: List of vertex that enclose the polygon, already projected to 2D.
+ * discarded_axis: Axis discarded to project the polygon to 2D (see
+ *                 get_discarded_axis). Calculated when the polygon is loaded.
+ * box_min: Lowest u and v of the vertex.
+ * box_max: Highest u and v of the vertex.
+ * slab_amount: Number of slabs. The polygon is split in horizontal slabs by
+ *              the v of its vertex, so no vertex is inside a slab.
+ * slab_v: Lowest v of each slab. It has one more position for the highest v of
+ *         the last slab.
+ * slab_starts: Position in 'slab_edges' of the first border of each slab. It
+ *              has one more position for the end of the last slab.
+ * slab_sorted: True for each slab whose borders don't cross each other. Their
+ *              borders are ordered from left to right.
+ * slab_edges: Borders that cross each slab.
  */
 typedef struct
 {
 	Plane plane;
 	int vertex_amount;
 	Coord2D *vertex;
+	Axis discarded_axis;
+	Coord2D box_min;
+	Coord2D box_max;
+	int slab_amount;
+	Real *slab_v;
+	int *slab_starts;
+	int *slab_sorted;
+	PolygonEdge *slab_edges;
 } Polygon;
 
-typedef enum { X_AXIS, Y_AXIS, Z_AXIS} Axis;
-
-void* get_polygon_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_polygon_normal_vector(Vector posn, void* polygon_ptr);
+void prepare_polygon(Polygon *polygon);
+void destroy_polygon(Polygon *polygon);
+void add_polygon_contour(Polygon *polygon, const Polygon *other);
+int get_polygon_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_polygon_normal_vector(Vector posn, void* polygon_ptr, int primitive);
+int get_polygon_bounds(void* polygon_ptr, BoundingBox *box);
 Coord2D transform_3d_to_2d(Vector point, Axis discarded_axis);
+Vector transform_2d_to_3d(Coord2D point, Plane plane);
 Axis get_discarded_axis(Plane plane);
 
 #endif
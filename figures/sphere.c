@@ -14,18 +14,20 @@
 #include "sphere.h"
 
 /*
- * Returns a pointer to the intersection between a sphere and a ray.
+ * Finds the intersections between a sphere and a ray. Returns the number of
+ * intersections found.
  *
  * eye: Position from which the ray is thrown.
  * dir_vec: Direction towards which the ray is thrown. Must be normalized
  * object_ptr: Pointer to the Object struct that represents the sphere
- * length: Output parameter for the number of intersections found.
+ * inter_list: Output list for the intersections found.
  */
-void* get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length)
+int get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list)
 {
-    Intersection *inter_found;
+    Intersection *inter_found = (Intersection*) inter_list;
 	Sphere* sphere_ptr =  (Sphere*) ((Object*)object_ptr)->figure;
-	long double a, b, c;
+	Real a, b, c, distances[2];
+	int length;
 	Vector inter_diff;
 	inter_diff.x = eye.x - sphere_ptr->center.x;
 	inter_diff.y = eye.y - sphere_ptr->center.y;
@@ -35,27 +37,24 @@ void* get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, int
 	b = 2.0 * (	dir_vec.x * (inter_diff.x) +
                 dir_vec.y * (inter_diff.y) +
 				dir_vec.z * (inter_diff.z));
-	c = pow(inter_diff.x, 2.0) +
-        pow(inter_diff.y, 2.0) +
-        pow(inter_diff.z, 2.0) -
-        pow(sphere_ptr->radius, 2.0);
+	c = inter_diff.x * inter_diff.x +
+        inter_diff.y * inter_diff.y +
+        inter_diff.z * inter_diff.z -
+        sphere_ptr->radius_pow;
 
 	// We obtain the distance between the eye and the intersection point
-	long double *distances = do_cuadratic_function(a, b, c);
-	if (!distances) return NULL;
+	length = do_cuadratic_function(a, b, c, distances);
     // We create the intersection object according to the distance
-    *length = is_one_distance(distances) ? 1 : 2;
-    inter_found = get_memory(sizeof(Intersection) * *length, NULL);
     int inter_i;
-    for(inter_i = 0; inter_i < *length; inter_i++)
+    for(inter_i = 0; inter_i < length; inter_i++)
     {
         inter_found[inter_i].posn = get_ray_position(eye, dir_vec, distances[inter_i]);
         inter_found[inter_i].distance = distances[inter_i];
-        inter_found[inter_i].obj = *((Object*)object_ptr);
+        inter_found[inter_i].obj = (Object*) object_ptr;
         inter_found[inter_i].is_valid = 1;
+        inter_found[inter_i].primitive = 0;
     }
-    free(distances);
-    return inter_found;
+    return length;
 }
 
 /*
@@ -64,11 +63,27 @@ void* get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, int
  *
  * posn: Position at which the intersection occured
  * sphere_ptr: Pointer to a sphere figure.
+ * primitive: Unused, spheres are a single surface.
  */
-Vector get_sphere_normal_vector(Vector posn, void* sphere_ptr)
+Vector get_sphere_normal_vector(Vector posn, void* sphere_ptr, int primitive)
 {
 	Sphere sphere = *((Sphere*) sphere_ptr);
-	Vector normal_vector = multiply_vector(1.0 / sphere.radius, subtract_vectors(posn, sphere.center));
+	Vector normal_vector = multiply_vector(sphere.inv_radius, subtract_vectors(posn, sphere.center));
 	return normal_vector;
 }
 
+/*
+ * Calculates the box that encloses a sphere. Spheres are always bounded.
+ *
+ * sphere_ptr: Pointer to a sphere figure.
+ * box: Output parameter for the box of the sphere.
+ */
+int get_sphere_bounds(void* sphere_ptr, BoundingBox *box)
+{
+	Sphere sphere = *((Sphere*) sphere_ptr);
+	Vector radius_vec = (Vector){ .x = sphere.radius, .y = sphere.radius, .z = sphere.radius };
+	box->min = subtract_vectors(sphere.center, radius_vec);
+	box->max = get_ray_position(sphere.center, radius_vec, 1);
+	return 1;
+}
+
@@ -2,20 +2,26 @@
 #define SPHERE_H
 
 #include "../tracing/vector.h"
+#include "../tracing/bounding_box.h"
 
 /*
  * Represents a sphere object
  *
  * radius: Radius of the sphere.
  * center: Position of the sphere of the sphere.
+ * radius_pow: Squared radius. Calculated when the sphere is loaded.
+ * inv_radius: Inverse of the radius. Calculated when the sphere is loaded.
  */
 typedef struct
 {
-	long double radius;
+	Real radius;
 	Vector center;
+	Real radius_pow;
+	Real inv_radius;
 } Sphere;
 
-void* get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, int *length);
-Vector get_sphere_normal_vector(Vector posn, void* sphere_ptr);
+int get_sphere_intersection(Vector eye, Vector dir_vec, void* object_ptr, void* inter_list);
+Vector get_sphere_normal_vector(Vector posn, void* sphere_ptr, int primitive);
+int get_sphere_bounds(void* sphere_ptr, BoundingBox *box);
 
 #endif
@@ -0,0 +1,176 @@
+/* obj_loader.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Reads triangle meshes from Wavefront OBJ files. Only the vertex ('v') and
+ * face ('f') lines are used, the rest of the file is ignored.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../utilities/memory_handler.h"
+#include "../utilities/error_handler.h"
+#include "../tracing/vector.h"
+#include "../figures/mesh.h"
+#include "obj_loader.h"
+
+// Maximum length of a line of an OBJ file
+#define OBJ_LINE_LENGTH 1024
+
+// Methods
+
+/*
+ * Exits the program with a 'mesh format' error code, and prints the line of
+ * the mesh file where the error occured.
+ *
+ * file_path: Path to the mesh file.
+ * line_number: Line of the file where the error occured.
+ */
+void throw_mesh_error(const char *file_path, int line_number)
+{
+    print_error(MESH_FORMAT_ERROR);
+    printf("File '%s', line %d", file_path, line_number);
+    exit(MESH_FORMAT_ERROR);
+}
+
+/*
+ * Returns the number of corners of a face line. Every token after the 'f' is a
+ * corner.
+ *
+ * line: Face line, without the leading 'f'.
+ */
+int count_face_corners(char *line)
+{
+    int corners = 0;
+    char *token;
+    for(token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) corners++;
+    return corners;
+}
+
+/*
+ * Reads the vertex position of a face corner. The corner may come as 'v',
+ * 'v/vt', 'v//vn' or 'v/vt/vn', only 'v' is used. Negative positions are
+ * relative to the last vertex read. Returns -1 if the corner is not valid.
+ *
+ * token: Corner of the face.
+ * vertex_read: Number of vertex read before the face.
+ */
+int read_face_corner(char *token, int vertex_read)
+{
+    char *end;
+    long position = strtol(token, &end, 10);
+    if(end == token || (*end != '\0' && *end != '/')) return -1;
+    if(position < 0) position += vertex_read;
+    else position--;
+    if(position < 0 || position >= vertex_read) return -1;
+    return (int) position;
+}
+
+/*
+ * Reads the next line of an OBJ file. Returns false at the end of the file.
+ * A line longer than OBJ_LINE_LENGTH would be read in pieces, and the pieces
+ * parsed as lines, so it is a format error.
+ *
+ * line: Output buffer for the line, with space for OBJ_LINE_LENGTH characters.
+ * file: OBJ file, opened for reading.
+ * file_path: Path to the OBJ file.
+ * line_number: Number of the last line read. It is increased with the new line.
+ */
+int read_obj_line(char *line, FILE *file, const char *file_path, int *line_number)
+{
+    int next_char;
+
+    if(!fgets(line, OBJ_LINE_LENGTH, file)) return 0;
+    (*line_number)++;
+    if(strchr(line, '\n') == NULL)
+    {
+        // The buffer may have been filled right before the end of the line
+        next_char = fgetc(file);
+        if(next_char != '\n' && next_char != EOF) throw_mesh_error(file_path, *line_number);
+    }
+    return 1;
+}
+
+/*
+ * Loads a triangle mesh from an OBJ file. The faces with more than three
+ * corners are split in triangles that share the first corner, so they must be
+ * convex. The file is read twice: first to count the vertex and the triangles,
+ * and then to store them.
+ *
+ * file_path: Path to the OBJ file.
+ */
+Mesh* load_obj_mesh(const char *file_path)
+{
+    FILE *file;
+    Mesh *mesh;
+    char line[OBJ_LINE_LENGTH];
+    char *token;
+    double coords[3];
+    int line_number, corners, first_corner, prev_corner, corner;
+
+    file = fopen(file_path, "r");
+    if(!file)
+    {
+        print_error(OPEN_FILE_ERROR);
+        printf("File '%s'", file_path);
+        exit(OPEN_FILE_ERROR);
+    }
+    mesh = (Mesh*) get_memory(sizeof(Mesh), NULL);
+    mesh->vertex_amount = 0;
+    mesh->triangle_amount = 0;
+    // Count the vertex and the triangles
+    line_number = 0;
+    while(read_obj_line(line, file, file_path, &line_number))
+    {
+        if(line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) mesh->vertex_amount++;
+        else if(line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+        {
+            corners = count_face_corners(line + 1);
+            if(corners < 3) throw_mesh_error(file_path, line_number);
+            mesh->triangle_amount += corners - 2;
+        }
+    }
+    mesh->vertex = (Vector*) get_memory(sizeof(Vector) * (mesh->vertex_amount + 1), NULL);
+    mesh->triangles = (int*) get_memory(sizeof(int) * 3 * (mesh->triangle_amount + 1), NULL);
+    // Store them
+    rewind(file);
+    mesh->vertex_amount = 0;
+    mesh->triangle_amount = 0;
+    line_number = 0;
+    while(read_obj_line(line, file, file_path, &line_number))
+    {
+        if(line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+        {
+            if(sscanf(line + 1, "%lf %lf %lf", &coords[0], &coords[1], &coords[2]) != 3)
+                throw_mesh_error(file_path, line_number);
+            mesh->vertex[mesh->vertex_amount].x = coords[0];
+            mesh->vertex[mesh->vertex_amount].y = coords[1];
+            mesh->vertex[mesh->vertex_amount].z = coords[2];
+            mesh->vertex_amount++;
+        }
+        else if(line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+        {
+            corners = 0;
+            first_corner = prev_corner = -1;
+            for(token = strtok(line + 1, " \t\r\n"); token; token = strtok(NULL, " \t\r\n"))
+            {
+                corner = read_face_corner(token, mesh->vertex_amount);
+                if(corner < 0) throw_mesh_error(file_path, line_number);
+                if(corners == 0) first_corner = corner;
+                else if(corners >= 2)
+                {
+                    mesh->triangles[3 * mesh->triangle_amount] = first_corner;
+                    mesh->triangles[3 * mesh->triangle_amount + 1] = prev_corner;
+                    mesh->triangles[3 * mesh->triangle_amount + 2] = corner;
+                    mesh->triangle_amount++;
+                }
+                prev_corner = corner;
+                corners++;
+            }
+        }
+    }
+    fclose(file);
+    build_mesh_hierarchy(mesh);
+    return mesh;
+}
@@ -0,0 +1,8 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "../figures/mesh.h"
+
+Mesh* load_obj_mesh(const char *file_path);
+
+#endif
@@ -0,0 +1,69 @@
+/* particle_loader.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Loads particle clouds from binary particle files. The file is mapped in
+ * memory and the particles are used where they are, so it is never parsed.
+ * A particle file holds, with the byte order of the machine:
+ *      - The number of particles, as a 32 bit unsigned integer.
+ *      - Flags, as a 32 bit unsigned integer. The bit 0 tells if the file has colors.
+ *      - The X coordinates of the centers, as 32 bit floats. Then the Y and the Z ones.
+ *      - The radius of each particle, as 32 bit floats.
+ *      - Optionally, the red, green and blue values (bytes from 0 to 255) of each particle.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "../utilities/memory_handler.h"
+#include "../utilities/error_handler.h"
+#include "../utilities/file_mapping.h"
+#include "../figures/particles.h"
+#include "particle_loader.h"
+
+// Size of the header (particle number and flags) of a particle file
+#define PARTICLE_HEADER_SIZE 8
+// Flag of the particle files that have colors
+#define PARTICLE_COLORS_FLAG 1
+
+// Methods
+
+/*
+ * Loads a cloud of particles from a particle file. The file is mapped in
+ * memory, so only the hierarchy over the particles is allocated.
+ *
+ * file_path: Path to the particle file.
+ */
+ParticleCloud* load_particle_file(const char *file_path)
+{
+    ParticleCloud *cloud;
+    const unsigned char *data;
+    const unsigned int *header;
+    size_t file_size, particle_amount, particle_size;
+
+    data = (const unsigned char*) map_file(file_path, &file_size);
+    header = (const unsigned int*) data;
+    particle_amount = file_size >= PARTICLE_HEADER_SIZE ? header[0] : 0;
+    particle_size = 4 * sizeof(float);
+    if(particle_amount && header[1] & PARTICLE_COLORS_FLAG) particle_size += 3;
+    // The number of particles is checked against the file first, so a wrong one can't overflow the size
+    if(!particle_amount || particle_amount > INT_MAX / 2 ||
+       particle_amount > (file_size - PARTICLE_HEADER_SIZE) / particle_size ||
+       file_size - PARTICLE_HEADER_SIZE != particle_amount * particle_size)
+    {
+        print_error(PARTICLES_FORMAT_ERROR);
+        printf("File '%s'", file_path);
+        exit(PARTICLES_FORMAT_ERROR);
+    }
+    cloud = (ParticleCloud*) get_memory(sizeof(ParticleCloud), NULL);
+    cloud->particle_amount = (int) particle_amount;
+    cloud->mapping = data;
+    cloud->mapping_size = file_size;
+    cloud->center_x = (const float*) (data + PARTICLE_HEADER_SIZE);
+    cloud->center_y = cloud->center_x + particle_amount;
+    cloud->center_z = cloud->center_y + particle_amount;
+    cloud->radius = cloud->center_z + particle_amount;
+    cloud->colors = header[1] & PARTICLE_COLORS_FLAG ? (const unsigned char*) (cloud->radius + particle_amount) : NULL;
+    build_particles_hierarchy(cloud);
+    return cloud;
+}
@@ -0,0 +1,8 @@
+#ifndef PARTICLE_LOADER_H
+#define PARTICLE_LOADER_H
+
+#include "../figures/particles.h"
+
+ParticleCloud* load_particle_file(const char *file_path);
+
+#endif
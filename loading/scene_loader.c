@@ -10,7 +10,9 @@
 #include <stdlib.h>
 #include <libconfig.h>
 #include <ctype.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
 #include "../scene_config.h"
 #include "../utilities/memory_handler.h"
 #include "../utilities/error_handler.h"
@@ -19,6 +21,7 @@
 #include "../tracing/color.h"
 #include "../tracing/object.h"
 #include "../tracing/light.h"
+#include "../tracing/intersection.h"
 #include "../figures/sphere.h"
 #include "../figures/plane.h"
 #include "../figures/polygon.h"
@@ -26,6 +29,19 @@
 #include "../figures/cylinder.h"
 #include "../figures/cone.h"
 #include "../figures/disc.h"
+#include "../figures/mesh.h"
+#include "../figures/instance.h"
+#include "../figures/heightfield.h"
+#include "../figures/particles.h"
+#include "../tracing/transform.h"
+#include "../tracing/figure.h"
+#include "../tracing/cached_ray.h"
+#include "obj_loader.h"
+#include "particle_loader.h"
+#include "scene_optimizer.h"
+
+// Margin added to the boxes of the figures
+#define BOUNDS_EPSILON (10 * REAL_TOLERANCE)
 
 // Figure types codes
 #define SPHERE_CODE 0
@@ -34,6 +50,10 @@
 #define DISC_CODE 3
 #define CYLINDER_CODE 4
 #define CONE_CODE 5
+#define MESH_CODE 6
+#define INSTANCE_CODE 7
+#define HEIGHTFIELD_CODE 8
+#define PARTICLES_CODE 9
 
 // Methods
 
@@ -43,7 +63,7 @@
  * setting: setting where the boolean attribute is located.
  * attr_path: path to the boolean attribute inside the setting.
  */
-long double load_boolean(config_setting_t *setting, char *attr_path)
+Real load_boolean(config_setting_t *setting, char *attr_path)
 {
     int result;
     if (!config_setting_lookup_bool(setting, attr_path, &result)) throw_config_error(setting, attr_path, "boolean");
@@ -56,7 +76,7 @@ long double load_boolean(config_setting_t *setting, char *attr_path)
  * setting: setting where the integer attribute is located.
  * attr_path: path to the integer attribute inside the setting.
  */
-long double load_int(config_setting_t *setting, char *attr_path)
+Real load_int(config_setting_t *setting, char *attr_path)
 {
     int result;
     if (!config_setting_lookup_int(setting, attr_path, &result)) throw_config_error(setting, attr_path, "int");
@@ -64,15 +84,87 @@ long double load_int(config_setting_t *setting, char *attr_path)
 }
 
 /*
- * Loads a long double from a configuration setting.
+ * Loads an optional integer from a configuration setting. If the attribute is
+ * not present, the default value is returned.
  *
- * setting: setting where the long double attribute is located.
- * attr_path: path to the long double attribute inside the setting.
+ * setting: setting where the integer attribute is located.
+ * attr_path: path to the integer attribute inside the setting.
+ * default_value: value returned when the attribute is missing.
  */
-long double load_long_double(config_setting_t *setting, char *attr_path)
+int load_optional_int(config_setting_t *setting, char *attr_path, int default_value)
+{
+    int result;
+    if (!config_setting_lookup_int(setting, attr_path, &result)) result = default_value;
+    return result;
+}
+
+/*
+ * Loads an optional boolean from a configuration setting. If the attribute is
+ * not present, the default value is returned.
+ *
+ * setting: setting where the boolean attribute is located.
+ * attr_path: path to the boolean attribute inside the setting.
+ * default_value: value returned when the attribute is missing.
+ */
+int load_optional_boolean(config_setting_t *setting, char *attr_path, int default_value)
+{
+    int result;
+    if (!config_setting_lookup_bool(setting, attr_path, &result)) result = default_value;
+    return result;
+}
+
+/*
+ * Loads an optional real number from a configuration setting. Whole numbers
+ * written without a decimal point (like 'antialiase_normal_angle = 45;') are
+ * integer settings, so they are also taken. If the attribute is not present,
+ * the default value is returned.
+ *
+ * setting: setting where the real attribute is located.
+ * attr_path: path to the real attribute inside the setting.
+ * default_value: value returned when the attribute is missing.
+ */
+Real load_optional_real(config_setting_t *setting, char *attr_path, Real default_value)
+{
+    double attr;
+    int int_attr;
+    if (config_setting_lookup_float(setting, attr_path, &attr)) return attr;
+    if (config_setting_lookup_int(setting, attr_path, &int_attr)) return int_attr;
+    return default_value;
+}
+
+/*
+ * Loads an optional string from a configuration setting, which must be one of
+ * the given names, and returns the position of the name. If the attribute is
+ * not present, the default value is returned. Unknown names return -1.
+ *
+ * setting: setting where the string attribute is located.
+ * attr_path: path to the string attribute inside the setting.
+ * names: names that the attribute can take.
+ * names_length: number of names.
+ * default_value: value returned when the attribute is missing.
+ */
+int load_optional_name(config_setting_t *setting, char *attr_path, const char **names, int names_length, int default_value)
+{
+    const char *attr;
+    int name_i;
+    if (!config_setting_lookup_string(setting, attr_path, &attr)) return default_value;
+    for(name_i = 0; name_i < names_length; name_i++)
+    {
+        if(!strcmp(attr, names[name_i])) return name_i;
+    }
+    return -1;
+}
+
+/*
+ * Loads a real number from a configuration setting.
+ *
+ * setting: setting where the real attribute is located.
+ * attr_path: path to the real attribute inside the setting.
+ */
+Real load_real(config_setting_t *setting, char *attr_path)
 {
     double attr;
-    long double result;
+    Real result;
     if (config_setting_lookup_float(setting, attr_path, &attr))
         result = attr;
     else
@@ -80,6 +172,19 @@ long double load_long_double(config_setting_t *setting, char *attr_path)
     return result;
 }
 
+/*
+ * Loads a string from a configuration setting.
+ *
+ * setting: setting where the string attribute is located.
+ * attr_path: path to the string attribute inside the setting.
+ */
+const char* load_string(config_setting_t *setting, char *attr_path)
+{
+    const char *result;
+    if (!config_setting_lookup_string(setting, attr_path, &result)) throw_config_error(setting, attr_path, "string");
+    return result;
+}
+
 /*
  * Loads a setting from the configuration file.
  *
@@ -114,9 +219,9 @@ config_setting_t* load_setting(config_setting_t *setting, char *setting_path)
 Vector load_vector(config_setting_t *setting)
 {
     Vector vec;
-    vec.x = load_long_double(setting, "x");
-    vec.y = load_long_double(setting, "y");
-    vec.z = load_long_double(setting, "z");
+    vec.x = load_real(setting, "x");
+    vec.y = load_real(setting, "y");
+    vec.z = load_real(setting, "z");
     return vec;
 }
 
@@ -128,9 +233,9 @@ Vector load_vector(config_setting_t *setting)
 Color load_color(config_setting_t *setting)
 {
     Color color;
-    color.red = load_long_double(setting, "red");
-    color.green = load_long_double(setting, "green");
-    color.blue = load_long_double(setting, "blue");
+    color.red = load_real(setting, "red");
+    color.green = load_real(setting, "green");
+    color.blue = load_real(setting, "blue");
     return color;
 }
 
@@ -138,8 +243,8 @@ Color load_color(config_setting_t *setting)
  * Loads a sphere figure from a setting.
  *
  * sphere_setting: setting where the sphere is located.
- * obj: object where the sphere intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to sphere.
+ *      If the parameter comes null, the type is not set.
  */
 Sphere* load_sphere(config_setting_t *sphere_setting, Object *obj)
 {
@@ -147,14 +252,13 @@ Sphere* load_sphere(config_setting_t *sphere_setting, Object *obj)
     config_setting_t *center_setting;
 
     sphere = (Sphere*)get_memory(sizeof(Sphere), NULL);
-    sphere->radius = load_long_double(sphere_setting, "radius");
+    sphere->radius = load_real(sphere_setting, "radius");
     center_setting = load_setting(sphere_setting, "center");
     sphere->center = load_vector(center_setting);
-    if(obj)
-    {
-        obj->get_intersections = &get_sphere_intersection;
-        obj->get_normal_vector = &get_sphere_normal_vector;
-    }
+    // Prepared constants
+    sphere->radius_pow = sphere->radius * sphere->radius;
+    sphere->inv_radius = 1.0 / sphere->radius;
+    if(obj) obj->type = FIGURE_SPHERE;
     return sphere;
 }
 
@@ -192,8 +296,8 @@ Plane create_plane(Vector dir_vec, Vector anchor, Vector eye)
  * This functions makes sure that the plane normal is looking towards the eye.
  *
  * plane_setting: setting where the plane is located.
- * obj: object where the plane intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to plane.
+ *      If the parameter comes null, the type is not set.
  * eye: Position towards which the plane should be facing.
  */
 Plane* load_plane(config_setting_t *plane_setting, Object *obj, Vector eye)
@@ -208,11 +312,7 @@ Plane* load_plane(config_setting_t *plane_setting, Object *obj, Vector eye)
 	direction = load_vector(dir_setting);
 	anchor = load_vector(anchor_setting);
 	*plane = create_plane(direction, anchor, eye);
-    if(obj)
-    {
-        obj->get_intersections = &get_plane_intersection;
-        obj->get_normal_vector = &get_plane_normal_vector;
-    }
+    if(obj) obj->type = FIGURE_PLANE;
     return plane;
 }
 
@@ -220,15 +320,15 @@ Plane* load_plane(config_setting_t *plane_setting, Object *obj, Vector eye)
  * Loads a polygon figure from a setting.
  *
  * polygon_setting: setting where the polygon is located.
- * obj: object where the polygon intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to polygon.
+ *      If the parameter comes null, the type is not set.
  * eye: Position towards which the plane should be facing.
  */
 Polygon* load_polygon(config_setting_t *polygon_setting, Object *obj, Vector eye)
 {
     Polygon *polygon;
     int vertex_i;
-    Axis discarded_axis;
+
     Vector *poly_points;
     Vector plane_dir_vec, vec1, vec2;
     config_setting_t *all_vertex_setting, *vertex_setting;
@@ -251,21 +351,18 @@ Polygon* load_polygon(config_setting_t *polygon_setting, Object *obj, Vector eye
         vec2 = subtract_vectors(poly_points[2], poly_points[0]);
         plane_dir_vec = do_cross_product(vec1, vec2);
         polygon->plane = create_plane(plane_dir_vec, poly_points[0], eye);
-        discarded_axis = get_discarded_axis(polygon->plane);
+        polygon->discarded_axis = get_discarded_axis(polygon->plane);
         // Map 3d vertex to 2d vertex
         for(vertex_i = 0; vertex_i < polygon->vertex_amount; vertex_i++)
-            polygon->vertex[vertex_i] = transform_3d_to_2d(poly_points[vertex_i], discarded_axis);
+            polygon->vertex[vertex_i] = transform_3d_to_2d(poly_points[vertex_i], polygon->discarded_axis);
+        prepare_polygon(polygon);
     }
     else
     {
         print_error(MISSING_VERTEX_ERROR);
         exit(MISSING_VERTEX_ERROR);
     }
-    if(obj)
-    {
-        obj->get_intersections = &get_polygon_intersection;
-        obj->get_normal_vector = &get_polygon_normal_vector;
-    }
+    if(obj) obj->type = FIGURE_POLYGON;
     return polygon;
 }
 
@@ -273,8 +370,8 @@ Polygon* load_polygon(config_setting_t *polygon_setting, Object *obj, Vector eye
  * Loads a disc figure from a setting.
  *
  * disc_setting: setting where the disc is located.
- * obj: object where the disc intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to disc.
+ *      If the parameter comes null, the type is not set.
  * eye: Position towards which the plane should be facing.
  */
 Disc* load_disc(config_setting_t *disc_setting, Object *obj, Vector eye)
@@ -292,18 +389,14 @@ Disc* load_disc(config_setting_t *disc_setting, Object *obj, Vector eye)
     disc->inner_focus2 = load_vector(in_focus2_sett);
     disc->ext_focus1 = load_vector(ext_focus1_sett);
     disc->ext_focus2 = load_vector(ext_focus2_sett);
-    disc->inner_dist = load_long_double(disc_setting, "inner_distance");
-    disc->ext_dist = load_long_double(disc_setting, "external_distance");
+    disc->inner_dist = load_real(disc_setting, "inner_distance");
+    disc->ext_dist = load_real(disc_setting, "external_distance");
     // Load plane using focus points
     vec1 = subtract_vectors(disc->ext_focus2, disc->ext_focus1);
     vec2 = subtract_vectors(disc->inner_focus1, disc->ext_focus1);
     plane_dir_vec = do_cross_product(vec1, vec2);
     disc->plane = create_plane(plane_dir_vec, disc->ext_focus1, eye);
-    if(obj)
-    {
-        obj->get_intersections = &get_disc_intersection;
-        obj->get_normal_vector = &get_disc_normal_vector;
-    }
+    if(obj) obj->type = FIGURE_DISC;
     return disc;
 }
 
@@ -311,8 +404,8 @@ Disc* load_disc(config_setting_t *disc_setting, Object *obj, Vector eye)
  * Loads a cylinder figure from a setting.
  *
  * cylinder_setting: setting where the cylinder is located.
- * obj: object where the cylinder intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to cylinder.
+ *      If the parameter comes null, the type is not set.
  */
 Cylinder* load_cylinder(config_setting_t *cylinder_setting, Object *obj)
 {
@@ -325,15 +418,14 @@ Cylinder* load_cylinder(config_setting_t *cylinder_setting, Object *obj)
     normalize_vector(&(cylinder->direction));
     anchor_setting = load_setting(cylinder_setting, "anchor");
     cylinder->anchor = load_vector(anchor_setting);
-	cylinder->radius = load_long_double(cylinder_setting, "radius");
+	cylinder->radius = load_real(cylinder_setting, "radius");
 	cylinder->is_finite = load_boolean(cylinder_setting, "is_finite");
-	cylinder->front_length = load_long_double(cylinder_setting, "front_length");
-	cylinder->back_length = - load_long_double(cylinder_setting, "back_length");
-    if(obj)
-    {
-        obj->get_intersections = &get_cylinder_intersection;
-        obj->get_normal_vector = &get_cylinder_normal_vector;
-    }
+	cylinder->front_length = load_real(cylinder_setting, "front_length");
+	cylinder->back_length = - load_real(cylinder_setting, "back_length");
+    // Prepared constants. For cones the radius is the width::height ratio.
+    cylinder->radius_pow = cylinder->radius * cylinder->radius;
+    cylinder->inv_radius = 1.0 / cylinder->radius;
+    if(obj) obj->type = FIGURE_CYLINDER;
     return cylinder;
 }
 
@@ -341,18 +433,147 @@ Cylinder* load_cylinder(config_setting_t *cylinder_setting, Object *obj)
  * Loads a cone figure from a setting.
  *
  * cone_setting: setting where the cone is located.
- * obj: object where the cone intersection and normal functions will be loaded.
- *      If the parameter comes null, the functions will not be assigned.
+ * obj: object whose figure type is set to cone.
+ *      If the parameter comes null, the type is not set.
  */
 Cone* load_cone(config_setting_t *cone_setting, Object *obj)
 {
     Cone *cone = (Cone*) load_cylinder(cone_setting, NULL);
-    if(obj)
+    if(obj) obj->type = FIGURE_CONE;
+    return cone;
+}
+
+/*
+ * Loads a triangle mesh figure from a setting. The triangles are read from the
+ * OBJ file given by the 'file' attribute.
+ *
+ * mesh_setting: setting where the mesh is located.
+ * obj: object whose figure type is set to mesh.
+ *      If the parameter comes null, the type is not set.
+ */
+Mesh* load_mesh(config_setting_t *mesh_setting, Object *obj)
+{
+    Mesh *mesh = load_obj_mesh(load_string(mesh_setting, "file"));
+    if(obj) obj->type = FIGURE_MESH;
+    return mesh;
+}
+
+/*
+ * Loads an instance figure from a setting. The instance uses one of the
+ * geometries loaded before it, so its figure is shared and not copied.
+ *
+ * instance_setting: setting where the instance is located.
+ * obj: object whose figure type is set to instance.
+ *      If the parameter comes null, the type is not set.
+ * conf: Structure where the scene configuration is being loaded.
+ */
+Instance* load_instance(config_setting_t *instance_setting, Object *obj, SceneConfig conf)
+{
+    Instance *instance;
+    Object *geometry;
+    Vector translation, rotation, scale;
+    int geometry_i;
+
+    geometry_i = load_int(instance_setting, "geometry");
+    translation = load_vector(load_setting(instance_setting, "translation"));
+    rotation = load_vector(load_setting(instance_setting, "rotation"));
+    scale = load_vector(load_setting(instance_setting, "scale"));
+    if(geometry_i < 0 || geometry_i >= conf.geometries_length || !conf.geometries[geometry_i].figure ||
+       scale.x == 0.0 || scale.y == 0.0 || scale.z == 0.0)
     {
-        obj->get_intersections = &get_cone_intersection;
-        obj->get_normal_vector = &get_cone_normal_vector;
+        print_error(INSTANCE_ERROR);
+        printf("Line %d", instance_setting->line);
+        exit(INSTANCE_ERROR);
     }
-    return cone;
+    geometry = &conf.geometries[geometry_i];
+    instance = (Instance*) get_memory(sizeof(Instance), NULL);
+    instance->to_world = build_transform(translation, rotation, scale);
+    // Instances of instances are flattened, so rays are only moved once
+    if(geometry->type == FIGURE_INSTANCE)
+    {
+        instance->to_world = combine_transforms(instance->to_world, ((Instance*) geometry->figure)->to_world);
+        geometry = &((Instance*) geometry->figure)->shape;
+    }
+    // The shape keeps the materials of the instance
+    instance->shape = obj ? *obj : (Object){ .figure = NULL };
+    instance->shape.figure = geometry->figure;
+    instance->shape.type = geometry->type;
+    instance->to_object = invert_transform(instance->to_world);
+    if(obj) obj->type = FIGURE_INSTANCE;
+    return instance;
+}
+
+/*
+ * Loads a heightfield figure from a setting. The heights are read from the raw
+ * file given by the 'file' attribute, which holds 'columns' x 'rows' floats (32
+ * bits, in the byte order of the machine) stored by rows. The first sample is
+ * placed on the 'anchor', and the 'size' vector gives the width (X), the
+ * height scale (Y) and the depth (Z) of the terrain.
+ *
+ * field_setting: setting where the heightfield is located.
+ * obj: object whose figure type is set to heightfield.
+ *      If the parameter comes null, the type is not set.
+ */
+Heightfield* load_heightfield(config_setting_t *field_setting, Object *obj)
+{
+    Heightfield *field;
+    Vector size;
+    FILE *file;
+    const char *file_path;
+    size_t sample_i, samples_length;
+
+    field = (Heightfield*) get_memory(sizeof(Heightfield), NULL);
+    file_path = load_string(field_setting, "file");
+    field->columns = load_int(field_setting, "columns");
+    field->rows = load_int(field_setting, "rows");
+    field->anchor = load_vector(load_setting(field_setting, "anchor"));
+    size = load_vector(load_setting(field_setting, "size"));
+    // The samples are indexed with int, so their number must fit in one
+    if(field->columns < 2 || field->rows < 2 || field->columns > INT_MAX / field->rows)
+    {
+        print_error(HEIGHTFIELD_FORMAT_ERROR);
+        printf("Line %d", field_setting->line);
+        exit(HEIGHTFIELD_FORMAT_ERROR);
+    }
+    file = fopen(file_path, "rb");
+    if(!file)
+    {
+        print_error(OPEN_FILE_ERROR);
+        printf("File '%s'", file_path);
+        exit(OPEN_FILE_ERROR);
+    }
+    samples_length = (size_t) field->columns * field->rows;
+    field->heights = (float*) get_memory(sizeof(float) * samples_length, NULL);
+    // The file must have exactly one float for each sample
+    if(fread(field->heights, sizeof(float), samples_length, file) != samples_length || fgetc(file) != EOF)
+    {
+        print_error(HEIGHTFIELD_FORMAT_ERROR);
+        printf("File '%s'", file_path);
+        exit(HEIGHTFIELD_FORMAT_ERROR);
+    }
+    fclose(file);
+    for(sample_i = 0; sample_i < samples_length; sample_i++)
+        field->heights[sample_i] = field->anchor.y + field->heights[sample_i] * size.y;
+    field->cell_x = size.x / (field->columns - 1);
+    field->cell_z = size.z / (field->rows - 1);
+    prepare_heightfield(field);
+    if(obj) obj->type = FIGURE_HEIGHTFIELD;
+    return field;
+}
+
+/*
+ * Loads a particle cloud figure from a setting. The particles are mapped from
+ * the binary particle file given by the 'file' attribute.
+ *
+ * cloud_setting: setting where the particle cloud is located.
+ * obj: object whose figure type is set to particles.
+ *      If the parameter comes null, the type is not set.
+ */
+ParticleCloud* load_particles(config_setting_t *cloud_setting, Object *obj)
+{
+    ParticleCloud *cloud = load_particle_file(load_string(cloud_setting, "file"));
+    if(obj) obj->type = FIGURE_PARTICLES;
+    return cloud;
 }
 
 /*
@@ -390,6 +611,18 @@ void* load_figure(config_setting_t *obj_setting, Object *obj, SceneConfig conf)
     case CONE_CODE:
         figure = load_cone(figure_setting, obj);
         break;
+    case MESH_CODE:
+        figure = load_mesh(figure_setting, obj);
+        break;
+    case INSTANCE_CODE:
+        figure = load_instance(figure_setting, obj, conf);
+        break;
+    case HEIGHTFIELD_CODE:
+        figure = load_heightfield(figure_setting, obj);
+        break;
+    case PARTICLES_CODE:
+        figure = load_particles(figure_setting, obj);
+        break;
     default:
         figure = NULL;
         break;
@@ -397,6 +630,34 @@ void* load_figure(config_setting_t *obj_setting, Object *obj, SceneConfig conf)
     return figure;
  }
 
+/*
+ * Loads the geometries shared by the instances and stores them in the
+ * 'conf->geometries' variable. Only the figure of each geometry is loaded. A
+ * geometry may be an instance of a previous geometry. The 'geometries' list is
+ * optional.
+ *
+ * cfg: loaded configuration file.
+ * conf: Structure where the scene configuration is being loaded.
+ */
+void load_geometries(config_t *cfg, SceneConfig *conf)
+{
+    int geometry_i, geometries_length;
+    Object curr_geometry;
+    config_setting_t *geometries_setting;
+
+    conf->geometries_length = 0;
+    geometries_setting = config_lookup(cfg, "geometries");
+    if(!geometries_setting) return;
+    geometries_length = config_setting_length(geometries_setting);
+    conf->geometries = (Object*) get_memory(sizeof(Object) * (geometries_length + 1), NULL);
+    for(geometry_i = 0; geometry_i < geometries_length; geometry_i++)
+    {
+        curr_geometry = (Object){ .figure = NULL };
+        curr_geometry.figure = load_figure(config_setting_get_elem(geometries_setting, geometry_i), &curr_geometry, *conf);
+        conf->geometries[conf->geometries_length++] = curr_geometry;
+    }
+}
+
 /*
  * Loads all the scene objects and stores them in the 'conf->objs' variable. The
  * size of the array will be stored in the 'conf->objs_length' variable.
@@ -418,15 +679,16 @@ void load_objects(config_t *cfg, SceneConfig *conf)
     for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
     {
         obj_setting = config_setting_get_elem(objs_setting, obj_i);
-        curr_obj.light_ambiental = load_long_double(obj_setting, "light_ambiental");
-        curr_obj.light_material = load_long_double(obj_setting, "light_material");
-        curr_obj.specular_material = load_long_double(obj_setting, "specular_material");
-        curr_obj.mirror_material = load_long_double(obj_setting, "mirror_material");
-        curr_obj.transparency_material = load_long_double(obj_setting, "transparency_material");
-        curr_obj.translucency_material = load_long_double(obj_setting, "translucency_material");
-        curr_obj.specular_pow = load_long_double(obj_setting, "specular_pow");
+        curr_obj.light_ambiental = load_real(obj_setting, "light_ambiental");
+        curr_obj.light_material = load_real(obj_setting, "light_material");
+        curr_obj.specular_material = load_real(obj_setting, "specular_material");
+        curr_obj.mirror_material = load_real(obj_setting, "mirror_material");
+        curr_obj.transparency_material = load_real(obj_setting, "transparency_material");
+        curr_obj.translucency_material = load_real(obj_setting, "translucency_material");
+        curr_obj.specular_pow = load_real(obj_setting, "specular_pow");
         color_setting = load_setting(obj_setting, "color");
         curr_obj.color = load_color(color_setting);
+        curr_obj.ignores_lights = 0;
         // Cutting planes
         planes_setting = load_setting(obj_setting, "cutting_planes");
         curr_obj.cutting_planes_length = config_setting_length(planes_setting);
@@ -446,6 +708,50 @@ void load_objects(config_t *cfg, SceneConfig *conf)
     }
 }
 
+/*
+ * Builds the bounding volume hierarchy over the scene objects. Objects that
+ * can't be enclosed by a box are stored on the 'conf->unbounded_objs' list
+ * instead. The boxes only enclose the part of the objects that is not cut by
+ * their cutting planes, and objects that are cut completely are left out. The
+ * figure tables of both lists are built too, in the same order. It must be
+ * called after the objects are loaded.
+ *
+ * conf: Structure where the scene configuration is being loaded.
+ */
+void load_objects_hierarchy(SceneConfig *conf)
+{
+    int obj_i, bounded_length, bvh_i;
+    int *bounded_objs;
+    BoundingBox *boxes;
+    Object *obj;
+
+    conf->unbounded_objs_length = bounded_length = 0;
+    conf->unbounded_objs = (int*) get_memory(sizeof(int) * (conf->objs_length + 1), NULL);
+    bounded_objs = (int*) get_memory(sizeof(int) * (conf->objs_length + 1), NULL);
+    boxes = (BoundingBox*) get_memory(sizeof(BoundingBox) * (conf->objs_length + 1), NULL);
+    for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
+    {
+        obj = &conf->objs[obj_i];
+        if(get_figure_bounds(obj, &boxes[bounded_length]))
+        {
+            boxes[bounded_length] = clip_box_by_planes(boxes[bounded_length], obj->cutting_planes, obj->cutting_planes_length);
+            if(is_box_empty(boxes[bounded_length])) continue;
+            // Small margin so the box tests never discard a hit on the border of the figure
+            boxes[bounded_length] = expand_box(boxes[bounded_length], BOUNDS_EPSILON);
+            bounded_objs[bounded_length++] = obj_i;
+        }
+        else conf->unbounded_objs[conf->unbounded_objs_length++] = obj_i;
+    }
+    conf->objs_bvh = build_bvh(boxes, bounded_length);
+    // The hierarchy stores positions in the bounded list, we need positions in 'conf->objs'
+    for(bvh_i = 0; bvh_i < conf->objs_bvh.indexes_length; bvh_i++)
+        conf->objs_bvh.indexes[bvh_i] = bounded_objs[conf->objs_bvh.indexes[bvh_i]];
+    conf->objs_tables = build_figure_tables(conf->objs, conf->objs_bvh.indexes, conf->objs_bvh.indexes_length);
+    conf->unbounded_tables = build_figure_tables(conf->objs, conf->unbounded_objs, conf->unbounded_objs_length);
+    free(bounded_objs);
+    free(boxes);
+}
+
 /*
  * Loads all the scene light sources and stores them in the 'conf->lights' variable.
  * The size of the array will be stored in the 'conf->lights_length' variable.
@@ -466,9 +772,9 @@ void load_lights(config_t *cfg, SceneConfig *conf)
     for(light_i = 0; light_i < conf->lights_length; light_i++)
     {
         light_setting = config_setting_get_elem(src_setting, light_i);
-        curr_light.const_att_factor = load_long_double(light_setting, "const_att_factor");
-        curr_light.lin_att_factor = load_long_double(light_setting, "lin_att_factor");
-        curr_light.expo_att_factor = load_long_double(light_setting, "expo_att_factor");
+        curr_light.const_att_factor = load_real(light_setting, "const_att_factor");
+        curr_light.lin_att_factor = load_real(light_setting, "lin_att_factor");
+        curr_light.expo_att_factor = load_real(light_setting, "expo_att_factor");
         color_setting = load_setting(light_setting, "color");
         anchor_setting = load_setting(light_setting, "anchor");
         curr_light.anchor = load_vector(anchor_setting);
@@ -486,11 +792,11 @@ void load_lights(config_t *cfg, SceneConfig *conf)
 void load_scene_window(config_t *cfg, SceneConfig *conf)
 {
     config_setting_t *win_setting = load_setting_from_cfg(cfg, "window");
-    conf->window.x_min = load_long_double(win_setting, "x_min");
-    conf->window.y_min = load_long_double(win_setting, "y_min");
-    conf->window.x_max = load_long_double(win_setting, "x_max");
-    conf->window.y_max = load_long_double(win_setting, "y_max");
-    conf->window.z_anchor = load_long_double(win_setting, "z_anchor");
+    conf->window.x_min = load_real(win_setting, "x_min");
+    conf->window.y_min = load_real(win_setting, "y_min");
+    conf->window.x_max = load_real(win_setting, "x_max");
+    conf->window.y_max = load_real(win_setting, "y_max");
+    conf->window.z_anchor = load_real(win_setting, "z_anchor");
 }
 
 /*
@@ -529,31 +835,133 @@ void load_environment_light(config_t *cfg, SceneConfig *conf)
     conf->environment_light = load_color(environment_setting);
 }
 
+/*
+ * Loads the metric and threshold that decide which pixel corners are divided
+ * by the antialiasing. Both are optional: the 'channel' metric and a threshold
+ * of 0 are used by default, so every corner whose color is not exactly the
+ * average of the pixel is divided. Corners can also be divided by the edges of
+ * the objects, if 'antialiase_geometry' is enabled (disabled by default). The
+ * largest angle between the normals of a smooth surface is given in degrees by
+ * 'antialiase_normal_angle' (30 by default).
+ *
+ * config_setting: setting where the image generation config is located.
+ * conf: Structure where the scene configuration is being loaded.
+ */
+void load_antialiase_criterion(config_setting_t *config_setting, SceneConfig *conf)
+{
+    // Ordered as the ColorMetric values
+    const char *metrics[] = { "channel", "luminance", "delta_e" };
+    int metric;
+
+    conf->antialiase_threshold = load_optional_real(config_setting, "antialiase_threshold", 0.0);
+    conf->antialiase_geometry = load_optional_boolean(config_setting, "antialiase_geometry", 0);
+    conf->antialiase_normal_cos = real_cos(load_optional_real(config_setting, "antialiase_normal_angle", 30.0) * M_PI / 180.0);
+    metric = load_optional_name(config_setting, "antialiase_metric", metrics, 3, COLOR_METRIC_CHANNEL);
+    if(metric < 0)
+    {
+        print_error(ANTIALIASE_METRIC_ERROR);
+        printf("Line %d", config_setting->line);
+        exit(ANTIALIASE_METRIC_ERROR);
+    }
+    conf->antialiase_metric = metric;
+}
+
+/*
+ * Loads the fixed sampling settings, which replace the adaptive antialiasing
+ * when 'antialiase_mode' is "fixed" (it is "adaptive" by default). Every pixel
+ * then throws 'pixel_samples' rays (16 by default), placed with the
+ * 'sample_pattern' ("r2" by default, or "stratified", which needs a square
+ * number of samples) and spread by the 'pixel_filter' ("tent" by default, or
+ * "box").
+ *
+ * config_setting: setting where the image generation config is located.
+ * conf: Structure where the scene configuration is being loaded.
+ */
+void load_fixed_sampling(config_setting_t *config_setting, SceneConfig *conf)
+{
+    // Ordered as the SamplePattern and PixelFilter values
+    const char *modes[] = { "adaptive", "fixed" };
+    const char *patterns[] = { "stratified", "r2" };
+    const char *filters[] = { "box", "tent" };
+    int mode, pattern, filter, grid_size;
+
+    mode = load_optional_name(config_setting, "antialiase_mode", modes, 2, 0);
+    pattern = load_optional_name(config_setting, "sample_pattern", patterns, 2, SAMPLE_PATTERN_R2);
+    filter = load_optional_name(config_setting, "pixel_filter", filters, 2, PIXEL_FILTER_TENT);
+    conf->pixel_samples = load_optional_int(config_setting, "pixel_samples", 16);
+    grid_size = (int) round(sqrt(conf->pixel_samples));
+    if(mode < 0 || pattern < 0 || filter < 0 || conf->pixel_samples < 1 ||
+       (pattern == SAMPLE_PATTERN_STRATIFIED && grid_size * grid_size != conf->pixel_samples))
+    {
+        print_error(SAMPLING_CONFIG_ERROR);
+        printf("Line %d", config_setting->line);
+        exit(SAMPLING_CONFIG_ERROR);
+    }
+    conf->fixed_sampling = mode;
+    conf->sample_pattern = pattern;
+    conf->pixel_filter = filter;
+}
+
 /*
  * Loads the configuration for image generation. It includes maximum transparency level,
- * maximum antialiasing level, maximum mirror level, and the dimensions of the image.
+ * maximum antialiasing level, maximum mirror level, the dimensions of the image, the
+ * number of threads used to paint it (optional, one thread by default), whether the
+ * scene optimizer runs (optional, disabled by default), the antialiasing criterion and
+ * the fixed sampling settings.
  *
  * cfg: loaded configuration file.
  * conf: Structure where the scene configuration is being loaded.
  */
 void load_image_gen_config(config_t *cfg, SceneConfig *conf)
 {
-    int cache_i;
-
     config_setting_t *config_setting = load_setting_from_cfg(cfg, "config");
     conf->max_transparency_level = load_int(config_setting, "max_transparency_level");
     conf->max_antialiase_level = load_int(config_setting, "max_antialiase_level");
     conf->max_mirror_level = load_int(config_setting, "max_mirror_level");
     conf->width_res = load_int(config_setting, "image_width");
     conf->height_res = load_int(config_setting, "image_height");
+    conf->thread_count = load_optional_int(config_setting, "thread_count", 1);
+    if(conf->thread_count < 1) conf->thread_count = 1;
+    conf->optimize_scene = load_optional_boolean(config_setting, "optimize_scene", 0);
+    load_antialiase_criterion(config_setting, conf);
+    load_fixed_sampling(config_setting, conf);
 
     conf->pixel_density = pow(2, conf->max_antialiase_level - 1);
-	conf->row_ray_count = (conf->width_res * conf->pixel_density) + 1;
+	conf->row_ray_count = (TILE_SIZE * conf->pixel_density) + 1;
 	conf->cache_size = (conf->pixel_density + 1) * conf->row_ray_count;
-	conf->ray_cache = get_memory(sizeof(CachedRay) * conf->cache_size, NULL);
-	// Initialize cache
-	for(cache_i = 0; cache_i < conf->cache_size; cache_i++)
-        conf->ray_cache[cache_i].row = -1;
+	// High antialiasing levels only take a few rays of each pixel row, so they are cached sparsely
+	conf->sparse_cache = conf->cache_size > SPARSE_CACHE_SIZE;
+	if(conf->sparse_cache) conf->cache_size = SPARSE_CACHE_SIZE;
+}
+
+/*
+ * Calculates how many of the nearest intersections are needed to paint a ray.
+ * Only the first one is needed when there are not any transparent objects,
+ * otherwise the ones that can be seen through the transparent objects too.
+ *
+ * conf: Structure where the scene configuration is being loaded. The objects
+ *       and the image generation config must be already loaded.
+ */
+void load_nearest_inters_length(SceneConfig *conf)
+{
+    int obj_index, has_transparency;
+    has_transparency = 0;
+    for(obj_index = 0; obj_index < conf->objs_length; obj_index++)
+    {
+        if(conf->objs[obj_index].transparency_material > 0.0) has_transparency = 1;
+    }
+    if(!has_transparency || conf->max_transparency_level < 1)
+    {
+        conf->nearest_inters_length = 1;
+        return;
+    }
+    if(conf->max_transparency_level + 1 > MAX_NEAREST_INTERSECTIONS)
+    {
+        print_error(TRANSPARENCY_LEVEL_ERROR);
+        printf("The maximum transparency level is %d", MAX_NEAREST_INTERSECTIONS - 1);
+        exit(TRANSPARENCY_LEVEL_ERROR);
+    }
+    conf->nearest_inters_length = conf->max_transparency_level + 1;
 }
 
 /*
@@ -579,10 +987,14 @@ SceneConfig load_scene(char* scene_file_path)
     load_eye(&cfg, &scene_config);
     load_scene_window(&cfg, &scene_config);
     load_background(&cfg, &scene_config);
+    load_geometries(&cfg, &scene_config);
     load_objects(&cfg, &scene_config);
     load_lights(&cfg, &scene_config);
     load_environment_light(&cfg, &scene_config);
     load_image_gen_config(&cfg, &scene_config);
+    if(scene_config.optimize_scene) optimize_scene(&scene_config);
+    load_nearest_inters_length(&scene_config);
+    load_objects_hierarchy(&scene_config);
     config_destroy(&cfg);
     return scene_config;
 }
@@ -0,0 +1,289 @@
+/* scene_optimizer.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Removes, merges and flags the scene objects that waste render time without
+ * changing the image. It runs after the scene is loaded, before the
+ * hierarchy is built, when the 'optimize_scene' setting is enabled.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../scene_config.h"
+#include "../tracing/vector.h"
+#include "../tracing/object.h"
+#include "../tracing/light.h"
+#include "../tracing/bounding_box.h"
+#include "../tracing/figure.h"
+#include "../figures/plane.h"
+#include "../figures/polygon.h"
+#include "scene_optimizer.h"
+
+// Number of directions that bound the rays thrown through the window
+#define VIEW_EDGES 4
+
+// Methods
+
+/*
+ * Returns true if a convex set is completely below a plane that crosses
+ * 'anchor' with the given normal, and the box is completely above it. The set
+ * is made of its 'points' and everything that can be reached from them by
+ * moving along the 'edges' directions.
+ *
+ * normal: Normal of the plane. It doesn't need to be normalized.
+ * anchor: Position on the plane.
+ * points: Points of the set.
+ * points_length: Number of points of the set.
+ * edges: Directions along which the set is unbounded.
+ * box: Box that is checked.
+ */
+int is_box_separated(Vector normal, Vector anchor, const Vector *points, int points_length,
+                     const Vector *edges, BoundingBox box)
+{
+    Vector corner;
+    Real offset;
+    int point_i, edge_i, corner_i;
+
+    if(normalize_vector(&normal) < REAL_TOLERANCE) return 0;
+    offset = do_dot_product(normal, anchor);
+    for(point_i = 0; point_i < points_length; point_i++)
+        if(do_dot_product(normal, points[point_i]) > offset + REAL_TOLERANCE) return 0;
+    for(edge_i = 0; edge_i < VIEW_EDGES; edge_i++)
+        if(do_dot_product(normal, edges[edge_i]) > 0) return 0;
+    for(corner_i = 0; corner_i < 8; corner_i++)
+    {
+        corner.x = corner_i & 1 ? box.max.x : box.min.x;
+        corner.y = corner_i & 2 ? box.max.y : box.min.y;
+        corner.z = corner_i & 4 ? box.max.z : box.min.z;
+        if(do_dot_product(normal, corner) <= offset + REAL_TOLERANCE) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Returns true if a box can be separated from the convex set that holds the
+ * eye, a light and every position seen through the window. The planes tried
+ * are the faces of the set (and their reverses), so the test may miss some
+ * boxes that could be separated, but it never separates a box that can't.
+ *
+ * points: The eye and the light. The light may be left out.
+ * points_length: Number of points (1 or 2).
+ * edges: Directions from the eye to the window corners.
+ * box: Box that is checked.
+ */
+int is_box_out_of_view(const Vector *points, int points_length, const Vector *edges, BoundingBox box)
+{
+    Vector normal;
+    int point_i, edge_i, other_i;
+
+    for(point_i = 0; point_i < points_length; point_i++)
+    {
+        // Faces through one point and two directions
+        for(edge_i = 0; edge_i < VIEW_EDGES; edge_i++)
+        for(other_i = edge_i + 1; other_i < VIEW_EDGES; other_i++)
+        {
+            normal = do_cross_product(edges[edge_i], edges[other_i]);
+            if(is_box_separated(normal, points[point_i], points, points_length, edges, box) ||
+               is_box_separated(multiply_vector(-1, normal), points[point_i], points, points_length, edges, box))
+                return 1;
+        }
+    }
+    // Faces through both points and one direction
+    for(edge_i = 0; points_length == 2 && edge_i < VIEW_EDGES; edge_i++)
+    {
+        normal = do_cross_product(subtract_vectors(points[1], points[0]), edges[edge_i]);
+        if(is_box_separated(normal, points[0], points, points_length, edges, box) ||
+           is_box_separated(multiply_vector(-1, normal), points[0], points, points_length, edges, box))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Returns true if an object can't change the image: it is not seen through the
+ * window, and it is not between any light and a position seen through the
+ * window, so it can't cast a shadow on it either. Rays that are reflected by a
+ * mirror may go anywhere, so it always returns false for scenes with mirrors.
+ * Unbounded objects are always kept.
+ *
+ * obj: Object that is checked.
+ * conf: Configuration of the scene.
+ * has_mirrors: True if the scene has reflections.
+ */
+int is_object_hidden(Object *obj, const SceneConfig *conf, int has_mirrors)
+{
+    BoundingBox box;
+    Vector points[2], edges[VIEW_EDGES];
+    int light_i;
+
+    if(has_mirrors || !get_figure_bounds(obj, &box)) return 0;
+    box = clip_box_by_planes(box, obj->cutting_planes, obj->cutting_planes_length);
+    points[0] = conf->eye;
+    edges[0] = subtract_vectors((Vector){ .x = conf->window.x_min, .y = conf->window.y_min, .z = conf->window.z_anchor }, conf->eye);
+    edges[1] = subtract_vectors((Vector){ .x = conf->window.x_max, .y = conf->window.y_min, .z = conf->window.z_anchor }, conf->eye);
+    edges[2] = subtract_vectors((Vector){ .x = conf->window.x_max, .y = conf->window.y_max, .z = conf->window.z_anchor }, conf->eye);
+    edges[3] = subtract_vectors((Vector){ .x = conf->window.x_min, .y = conf->window.y_max, .z = conf->window.z_anchor }, conf->eye);
+    if(!conf->lights_length) return is_box_out_of_view(points, 1, edges, box);
+    for(light_i = 0; light_i < conf->lights_length; light_i++)
+    {
+        points[1] = conf->lights[light_i].anchor;
+        if(!is_box_out_of_view(points, 2, edges, box)) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Returns true if an object can't be hit because its cutting planes cut its
+ * whole figure. Unbounded objects are always kept.
+ *
+ * obj: Object that is checked.
+ */
+int is_object_cut_away(Object *obj)
+{
+    BoundingBox box;
+    if(!obj->cutting_planes_length || !get_figure_bounds(obj, &box)) return 0;
+    return is_box_empty(clip_box_by_planes(box, obj->cutting_planes, obj->cutting_planes_length));
+}
+
+/*
+ * Returns true if two objects have the same color and materials.
+ *
+ * obj: First object.
+ * other: Second object.
+ */
+int have_same_materials(Object *obj, Object *other)
+{
+    return obj->color.red == other->color.red &&
+           obj->color.green == other->color.green &&
+           obj->color.blue == other->color.blue &&
+           obj->light_material == other->light_material &&
+           obj->light_ambiental == other->light_ambiental &&
+           obj->specular_material == other->specular_material &&
+           obj->mirror_material == other->mirror_material &&
+           obj->transparency_material == other->transparency_material &&
+           obj->translucency_material == other->translucency_material &&
+           obj->specular_pow == other->specular_pow;
+}
+
+/*
+ * Returns true if two polygon objects can be merged in a single polygon: they
+ * have the same materials and no cutting planes, they are on the same plane,
+ * and their boxes on the plane don't overlap. They are only merged if the box
+ * of the merged polygon is not larger than both boxes, so the hierarchy
+ * doesn't get worse (for example the tiles of a floor).
+ *
+ * obj: First polygon object.
+ * other: Second polygon object.
+ */
+int can_merge_polygons(Object *obj, Object *other)
+{
+    Polygon *polygon, *other_polygon;
+    Real area, other_area, merged_area;
+
+    if(obj->type != FIGURE_POLYGON || other->type != FIGURE_POLYGON) return 0;
+    if(obj->cutting_planes_length || other->cutting_planes_length || !have_same_materials(obj, other)) return 0;
+    polygon = (Polygon*) obj->figure;
+    other_polygon = (Polygon*) other->figure;
+    if(polygon->discarded_axis != other_polygon->discarded_axis ||
+       do_dot_product(polygon->plane.direction, other_polygon->plane.direction) < 1 - REAL_TOLERANCE ||
+       real_abs(polygon->plane.offset - other_polygon->plane.offset) > REAL_TOLERANCE)
+        return 0;
+    // The boxes may touch, but not overlap
+    if(real_min(polygon->box_max.u, other_polygon->box_max.u) > real_max(polygon->box_min.u, other_polygon->box_min.u) &&
+       real_min(polygon->box_max.v, other_polygon->box_max.v) > real_max(polygon->box_min.v, other_polygon->box_min.v))
+        return 0;
+    area = (polygon->box_max.u - polygon->box_min.u) * (polygon->box_max.v - polygon->box_min.v);
+    other_area = (other_polygon->box_max.u - other_polygon->box_min.u) * (other_polygon->box_max.v - other_polygon->box_min.v);
+    merged_area = (real_max(polygon->box_max.u, other_polygon->box_max.u) - real_min(polygon->box_min.u, other_polygon->box_min.u)) *
+                  (real_max(polygon->box_max.v, other_polygon->box_max.v) - real_min(polygon->box_min.v, other_polygon->box_min.v));
+    return merged_area <= (area + other_area) * (1 + REAL_TOLERANCE);
+}
+
+/*
+ * Frees the memory used by an object that is removed from the scene: its
+ * figure and its cutting planes.
+ *
+ * obj: Object that is removed.
+ */
+void destroy_removed_object(Object *obj)
+{
+    destroy_figure(obj);
+    // The cutting planes are only allocated when the object has some
+    if(obj->cutting_planes_length) free(obj->cutting_planes);
+    obj->cutting_planes = NULL;
+    obj->cutting_planes_length = 0;
+}
+
+/*
+ * Removes, merges and flags the scene objects that waste render time. It must
+ * be called after the objects, lights and image generation config are loaded,
+ * and before the hierarchy is built. It prints a summary of the changes.
+ *      - Objects whose cutting planes cut their whole figure are removed.
+ *      - Objects that can't be seen or cast a shadow on what is seen are removed.
+ *      - Touching polygons on the same plane with the same materials are merged.
+ *      - Objects whose light and specular materials are 0 are flagged, so they
+ *        don't throw shadow rays.
+ *
+ * conf: Structure where the scene configuration is being loaded.
+ */
+void optimize_scene(SceneConfig *conf)
+{
+    Object *obj;
+    int obj_i, other_i, kept_length, has_mirrors, merged;
+    int cut_amount, hidden_amount, merged_amount, unlit_amount;
+
+    cut_amount = hidden_amount = merged_amount = unlit_amount = 0;
+    has_mirrors = 0;
+    for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
+    {
+        if(conf->max_mirror_level > 0 && conf->objs[obj_i].mirror_material > 0.0) has_mirrors = 1;
+    }
+    kept_length = 0;
+    for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
+    {
+        obj = &conf->objs[obj_i];
+        if(is_object_cut_away(obj)) cut_amount++;
+        else if(is_object_hidden(obj, conf, has_mirrors)) hidden_amount++;
+        else
+        {
+            conf->objs[kept_length++] = *obj;
+            continue;
+        }
+        destroy_removed_object(obj);
+    }
+    conf->objs_length = kept_length;
+    // Merge each polygon with the following ones, until none of them can be merged
+    kept_length = 0;
+    for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
+    {
+        obj = &conf->objs[obj_i];
+        if(!obj->figure) continue;
+        do
+        {
+            merged = 0;
+            for(other_i = obj_i + 1; other_i < conf->objs_length; other_i++)
+            {
+                if(!conf->objs[other_i].figure || !can_merge_polygons(obj, &conf->objs[other_i])) continue;
+                add_polygon_contour((Polygon*) obj->figure, (Polygon*) conf->objs[other_i].figure);
+                destroy_removed_object(&conf->objs[other_i]);
+                merged_amount++;
+                merged = 1;
+            }
+        } while(merged);
+        conf->objs[kept_length++] = *obj;
+    }
+    conf->objs_length = kept_length;
+    for(obj_i = 0; obj_i < conf->objs_length; obj_i++)
+    {
+        obj = &conf->objs[obj_i];
+        // pow(0, 0) is 1, so the specular light only vanishes for positive powers
+        if(obj->light_material == 0.0 && obj->specular_material == 0.0 && obj->specular_pow > 0.0)
+        {
+            obj->ignores_lights = 1;
+            unlit_amount++;
+        }
+    }
+    printf("Scene optimizer: %d objects cut away, %d hidden objects removed, %d polygons merged into others, "
+           "%d objects ignore the lights\n", cut_amount, hidden_amount, merged_amount, unlit_amount);
+}
@@ -0,0 +1,8 @@
+#ifndef SCENE_OPTIMIZER_H
+#define SCENE_OPTIMIZER_H
+
+#include "../scene_config.h"
+
+void optimize_scene(SceneConfig *conf);
+
+#endif
@@ -18,10 +18,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
 #include "scene_config.h"
 #include "utilities/memory_handler.h"
 #include "utilities/error_handler.h"
 #include "utilities/file_handler.h"
+#include "utilities/work_queue.h"
 #include "loading/scene_loader.h"
 #include "tracing/color.h"
 #include "tracing/window.h"
@@ -30,50 +33,256 @@
 #include "tracing/light_f.h"
 #include "tracing/intersection.h"
 #include "tracing/cached_ray.h"
+#include "tracing/ray_packet.h"
+#include "tracing/color_difference.h"
+#include "tracing/figure.h"
+#include "tracing/pixel_sampler.h"
 
 /*
- * Returns the color found by a ray thrown from the eye towards a coordinate
- * from the scene window.
+ * Keeps track of how much of the image has already been painted. It is shared
+ * by all the workers that paint the scene.
+ *
+ * tiles_length: Number of tiles in the image.
+ * tiles_done: Number of tiles that have already been painted.
+ * percentage: Last percentage that was reported.
+ * estimates_time: True if the remaining time is reported too. It is only known when the time needed to
+ *                 paint each tile is similar (with fixed sampling).
+ * start_time: Time at which the painting started.
+ * lock: Protects the progress from concurrent updates.
+ */
+typedef struct
+{
+    int tiles_length;
+    int tiles_done;
+    int percentage;
+    int estimates_time;
+    time_t start_time;
+    pthread_mutex_t lock;
+} RenderProgress;
+
+/*
+ * Holds what changes while a worker paints the scene. The scene configuration
+ * is shared by all the workers and never written, so everything a worker
+ * writes lives here.
+ *
+ * ray_cache: Cache for ray colors. It holds 'cache_size' rays (see SceneConfig).
+ * borders: Rays on the tile borders. They are shared by all the workers, without locks (see cached_ray.h).
+ *          It is NULL with fixed sampling, which doesn't throw the rays of the lattice.
+ * rays_traced: Number of rays thrown from the eye.
+ * rays_reused: Number of rays whose color was taken from the ray cache.
+ * rays_shared: Number of rays taken from the tile borders, that another worker or tile had traced.
+ * subpixels_divided: Number of subpixels painted by the antialiasing, for each level.
+ * subpixels_avoided: Number of pixel corners, for each level of their subpixels, whose color was not the
+ *                    average of the pixel, but close enough to it (see 'antialiase_threshold' in SceneConfig).
+ */
+typedef struct
+{
+    RayCache ray_cache;
+    TileBorders *borders;
+    long rays_traced;
+    long rays_reused;
+    long rays_shared;
+    long *subpixels_divided;
+    long *subpixels_avoided;
+} RenderState;
+
+/*
+ * Holds everything a worker thread needs to paint its share of the image.
+ *
+ * conf: Configuration of the scene, shared by all the workers.
+ * state: Render state of the worker (ray cache and counters).
+ * worker_index: Index of the worker. It is also the index of its work deque.
+ * queue: Queue from which the worker takes the tiles to paint.
+ * writer: Writer of the image, shared by all the workers.
+ * progress: Progress shared by all the workers.
+ */
+typedef struct
+{
+    const SceneConfig *conf;
+    RenderState state;
+    int worker_index;
+    WorkQueue *queue;
+    ImageWriter *writer;
+    RenderProgress *progress;
+} RenderWorker;
+
+/*
+ * Returns the normalized direction of a ray thrown from the eye towards a
+ * coordinate from the scene window.
  *
  * w_coord: Horizontal coordinate of the scene window.
  * h_coord: Vertical coordinate of the scene window.
  * conf: Configuration of the scene.
- * current_row: Current row of the image being painted.
  */
-Color get_ray_color(long double w_coord, long double h_coord, SceneConfig conf, int current_row)
+Vector get_primary_ray(Real w_coord, Real h_coord, const SceneConfig *conf)
 {
-    int w_cache, h_cache, cache_index;
-    CachedRay cached_ray;
-    long double x_window, y_window, z_window;
+    Real x_window, y_window, z_window;
     Vector dir_vec;
-    // Get cached ray according to given coordinates
-    w_cache = w_coord * conf.pixel_density;
-    h_cache = (h_coord - current_row) * conf.pixel_density * conf.row_ray_count;
-    cache_index = w_cache + h_cache;
-    cached_ray = conf.ray_cache[cache_index];
-    if(h_cache == 0 && cached_ray.row > -1)
+    // Map the framebuffer position to universal coordinates
+    x_window = conf->window.x_min + ((w_coord * (conf->window.x_max - conf->window.x_min)) / conf->width_res);
+    y_window = conf->window.y_min + ((h_coord * (conf->window.y_max - conf->window.y_min)) / conf->height_res);
+    z_window = conf->window.z_anchor;
+    // Get the ray vector for the current pixel
+    dir_vec.x = x_window - conf->eye.x;
+    dir_vec.y = y_window - conf->eye.y;
+    dir_vec.z = z_window - conf->eye.z;
+    normalize_vector(&dir_vec);
+    return dir_vec;
+}
+
+/*
+ * Stores in a cached ray what the ray hit first: the object, and its normal
+ * if the antialiasing uses the geometry.
+ *
+ * cached_ray: Cached ray where the geometry is stored.
+ * inter_list: Nearest intersections of the ray, ordered from the nearest to the farthest.
+ * inter_length: Number of intersections found.
+ * conf: Configuration of the scene.
+ */
+void set_ray_geometry(CachedRay *cached_ray, Intersection *inter_list, int inter_length, const SceneConfig *conf)
+{
+    cached_ray->obj = inter_length ? inter_list[0].obj : NULL;
+    if(conf->antialiase_geometry && inter_length)
+        cached_ray->normal = get_figure_normal_vector(inter_list[0].posn, inter_list[0].obj, inter_list[0].primitive);
+}
+
+/*
+ * Looks for the ray of a lattice point in the ray cache, and then among the
+ * rays shared by the other workers on the tile borders. Returns true if the
+ * ray is known.
+ *
+ * lattice_w: Horizontal position of the point in the lattice.
+ * lattice_h: Vertical position of the point in the lattice.
+ * state: Render state of the worker that is painting.
+ * ray: Output parameter for the ray.
+ */
+int find_cached_ray(int lattice_w, int lattice_h, RenderState *state, CachedRay *ray)
+{
+    SharedRay *shared_ray;
+
+    if(get_cached_ray(&state->ray_cache, lattice_w, lattice_h, ray)) return 1;
+    shared_ray = find_border_ray(state->borders, lattice_w, lattice_h);
+    if(shared_ray == NULL || !get_shared_ray(shared_ray, ray)) return 0;
+    add_cached_ray(&state->ray_cache, ray);
+    state->rays_shared++;
+    return 1;
+}
+
+/*
+ * Stores a traced ray in the ray cache, and shares it with the other workers
+ * if it is on a tile border.
+ *
+ * ray: Traced ray, with its color and geometry already set.
+ * lattice_w: Horizontal position of the ray in the lattice.
+ * lattice_h: Vertical position of the ray in the lattice.
+ * state: Render state of the worker that is painting.
+ */
+void store_traced_ray(CachedRay *ray, int lattice_w, int lattice_h, RenderState *state)
+{
+    SharedRay *shared_ray;
+
+    ray->lattice_w = lattice_w;
+    ray->lattice_h = lattice_h;
+    add_cached_ray(&state->ray_cache, ray);
+    shared_ray = find_border_ray(state->borders, lattice_w, lattice_h);
+    if(shared_ray != NULL) share_ray(shared_ray, ray);
+    state->rays_traced++;
+}
+
+/*
+ * Returns the ray thrown from the eye towards a coordinate from the scene
+ * window, with the color it found and what it hit.
+ *
+ * w_coord: Horizontal coordinate of the scene window. It must be on the lattice (see SceneConfig).
+ * h_coord: Vertical coordinate of the scene window. It must be on the lattice too.
+ * conf: Configuration of the scene.
+ * state: Render state of the worker that is painting.
+ */
+CachedRay get_ray(Real w_coord, Real h_coord, const SceneConfig *conf, RenderState *state)
+{
+    Intersection inter_list[MAX_NEAREST_INTERSECTIONS];
+    Vector dir_vec;
+    int lattice_w, lattice_h, inter_length;
+    CachedRay ray;
+
+    // Lattice coordinates are exact, the subpixels halve the pixels
+    lattice_w = w_coord * conf->pixel_density;
+    lattice_h = h_coord * conf->pixel_density;
+    // Check if we already know the color for this ray
+    if(find_cached_ray(lattice_w, lattice_h, state, &ray))
     {
-        cached_ray = conf.ray_cache[w_cache + conf.pixel_density * conf.row_ray_count];
-        cached_ray.row = current_row;
+        state->rays_reused++;
+        return ray;
     }
-    // Check if we already know the color for this ray
-    if(cached_ray.row < current_row)
+    // We save the color of the pixel
+    dir_vec = get_primary_ray(w_coord, h_coord, conf);
+    inter_length = get_nearest_intersections(conf->eye, dir_vec, conf->nearest_inters_length, inter_list, conf);
+    ray.color = get_found_color(conf->eye, dir_vec, inter_list, inter_length, 0, conf);
+    set_ray_geometry(&ray, inter_list, inter_length, conf);
+    store_traced_ray(&ray, lattice_w, lattice_h, state);
+    return ray;
+}
+
+/*
+ * Finds the nearest intersections of a packet of primary rays, and stores the
+ * color of each ray in the ray cache.
+ *
+ * packet: Packet with the rays to trace.
+ * lattice_ws: Horizontal position in the lattice of each ray of the packet.
+ * lattice_h: Vertical position in the lattice of the rays.
+ * conf: Configuration of the scene.
+ * state: Render state of the worker that is painting.
+ */
+void trace_ray_packet(const RayPacket *packet, const int *lattice_ws, int lattice_h, const SceneConfig *conf, RenderState *state)
+{
+    Intersection inter_lists[PACKET_SIZE][MAX_NEAREST_INTERSECTIONS];
+    int inter_lengths[PACKET_SIZE];
+    CachedRay ray;
+    int lane;
+
+    get_packet_nearest_intersections(packet, conf->nearest_inters_length, inter_lists, inter_lengths, conf);
+    for(lane = 0; lane < packet->length; lane++)
     {
-        // Map the framebuffer position to universal coordinates
-        x_window = conf.window.x_min + ((w_coord * (conf.window.x_max - conf.window.x_min)) / conf.width_res);
-        y_window = conf.window.y_min + ((h_coord * (conf.window.y_max - conf.window.y_min)) / conf.height_res);
-        z_window = conf.window.z_anchor;
-        // Get the ray vector for the current pixel
-        dir_vec.x = x_window - conf.eye.x;
-        dir_vec.y = y_window - conf.eye.y;
-        dir_vec.z = z_window - conf.eye.z;
-        normalize_vector(&dir_vec);
-        // We save the color of the pixel
-        cached_ray.color = get_color(conf.eye, dir_vec, 0, conf);
-        cached_ray.row = current_row;
+        ray.color = get_found_color(packet->eye, get_packet_ray(packet, lane), inter_lists[lane], inter_lengths[lane], 0, conf);
+        set_ray_geometry(&ray, inter_lists[lane], inter_lengths[lane], conf);
+        store_traced_ray(&ray, lattice_ws[lane], lattice_h, state);
     }
-    conf.ray_cache[cache_index] = cached_ray;
-    return cached_ray.color;
+}
+
+/*
+ * Traces the rays thrown towards the pixel corners of an image row which are
+ * not cached yet, in packets of PACKET_SIZE rays. Every pixel needs these rays
+ * (see get_pixel_color), and neighbour rays are likely to go through the same
+ * nodes of the bounding volume hierarchy, so they are traced together.
+ *
+ * h_coord: Vertical coordinate of the corners.
+ * w_begin: Horizontal coordinate of the first corner.
+ * w_end: Horizontal coordinate of the last corner.
+ * conf: Configuration of the scene.
+ * state: Render state of the worker that is painting.
+ */
+void trace_corner_rays(int h_coord, int w_begin, int w_end, const SceneConfig *conf, RenderState *state)
+{
+    RayPacket packet;
+    CachedRay ray;
+    int lattice_ws[PACKET_SIZE];
+    int w_coord, lattice_h;
+
+    packet.eye = conf->eye;
+    packet.length = 0;
+    lattice_h = h_coord * conf->pixel_density;
+    for(w_coord = w_begin; w_coord <= w_end; w_coord++)
+    {
+        lattice_ws[packet.length] = w_coord * conf->pixel_density;
+        if(find_cached_ray(lattice_ws[packet.length], lattice_h, state, &ray)) continue;
+        add_packet_ray(&packet, get_primary_ray(w_coord, h_coord, conf));
+        if(packet.length == PACKET_SIZE)
+        {
+            trace_ray_packet(&packet, lattice_ws, lattice_h, conf, state);
+            packet.length = 0;
+        }
+    }
+    if(packet.length) trace_ray_packet(&packet, lattice_ws, lattice_h, conf, state);
 }
 
 /*
@@ -102,17 +311,42 @@ Color get_avg_color(Color *ray_colors)
 }
 
 /*
- * Returns true if the two given colors are not equal. This function is used to
- * determine if it is needed to go a level deeper for the antialiasing.
- * ToDo: Add a new parameter to configure the 'too_different' crieteria.
+ * Returns true if the difference between the two given colors, measured with
+ * the antialiasing metric, is above the antialiasing threshold. This function
+ * is used to determine if it is needed to go a level deeper for the
+ * antialiasing.
  *
  * color1: First color that will be compared.
  * color2: Second color that will be compared.
  * conf: Configuration of the scene.
  */
-int are_colors_too_different(Color color1, Color color2)
+int are_colors_too_different(Color color1, Color color2, const SceneConfig *conf)
+{
+    return get_color_difference(color1, color2, conf->antialiase_metric) > conf->antialiase_threshold;
+}
+
+/*
+ * Returns true if a corner of a pixel is on the other side of an object edge
+ * than another corner: they hit different objects (or only one of them hit an
+ * object), or they hit the same object with normals too different. It always
+ * returns false if the antialiasing doesn't use the geometry.
+ *
+ * rays: Rays thrown towards the four corners of the pixel.
+ * corner_i: Corner that is checked.
+ * conf: Configuration of the scene.
+ */
+int is_corner_on_edge(const CachedRay *rays, int corner_i, const SceneConfig *conf)
 {
-    return color1.red != color2.red || color1.green != color2.green || color1.blue != color2.blue;
+    int other_i;
+
+    if(!conf->antialiase_geometry) return 0;
+    for(other_i = 0; other_i < 4; other_i++)
+    {
+        if(rays[other_i].obj != rays[corner_i].obj) return 1;
+        if(rays[corner_i].obj && do_dot_product(rays[other_i].normal, rays[corner_i].normal) < conf->antialiase_normal_cos)
+            return 1;
+    }
+    return 0;
 }
 
 /*
@@ -130,42 +364,188 @@ int are_colors_too_different(Color color1, Color color2)
  *          Level 4 -> Subpixel, one eigth the size and width of a normal pixel
  *          etc...
  * conf: Configuration of the scene.
- * current_row: Current row of the image being painted.
+ * state: Render state of the worker that is painting.
  */
-Color get_pixel_color(long double w_coord, long double h_coord, int level, SceneConfig conf, int current_row)
+Color get_pixel_color(Real w_coord, Real h_coord, int level, const SceneConfig *conf, RenderState *state)
 {
+    CachedRay rays[4];
     Color colors[4];
     Color avg_color;
-    long double vertex_diff, sub_pixel_diff;
+    Real vertex_diff, sub_pixel_diff;
+    int corner_i;
 
-    vertex_diff = 1.0 / level;
+    vertex_diff = 1.0 / pow(2, level - 1);
     // Throw a ray for all vertex of the pixel
-    colors[0] = get_ray_color(w_coord, h_coord, conf, current_row);
-    colors[1] = get_ray_color(w_coord + vertex_diff, h_coord, conf, current_row);
-    colors[2] = get_ray_color(w_coord, h_coord + vertex_diff, conf, current_row);
-    colors[3] = get_ray_color(w_coord + vertex_diff, h_coord + vertex_diff, conf, current_row);
+    rays[0] = get_ray(w_coord, h_coord, conf, state);
+    rays[1] = get_ray(w_coord + vertex_diff, h_coord, conf, state);
+    rays[2] = get_ray(w_coord, h_coord + vertex_diff, conf, state);
+    rays[3] = get_ray(w_coord + vertex_diff, h_coord + vertex_diff, conf, state);
+    for(corner_i = 0; corner_i < 4; corner_i++)
+        colors[corner_i] = rays[corner_i].color;
     avg_color = get_avg_color(colors);
     // Check if we have reached the max antialiasing level
-    if(level + 1 > conf.max_antialiase_level) return avg_color;
+    if(level + 1 > conf->max_antialiase_level) return avg_color;
     // Antialiase
     sub_pixel_diff = vertex_diff / 2.0;
-    if(are_colors_too_different(colors[0], avg_color))
+    // Corners are ordered as upper left, upper right, lower left and lower right
+    for(corner_i = 0; corner_i < 4; corner_i++)
+    {
+        if(are_colors_too_different(colors[corner_i], avg_color, conf) || is_corner_on_edge(rays, corner_i, conf))
+        {
+            colors[corner_i] = get_pixel_color(w_coord + (corner_i & 1) * sub_pixel_diff, h_coord + (corner_i >> 1) * sub_pixel_diff,
+                                               level+1, conf, state);
+            state->subpixels_divided[level + 1]++;
+        }
+        else if(colors[corner_i].red != avg_color.red || colors[corner_i].green != avg_color.green ||
+                colors[corner_i].blue != avg_color.blue)
+        {
+            state->subpixels_avoided[level + 1]++;
+        }
+    }
+    return get_avg_color(colors);
+}
+
+/*
+ * Returns the color of a pixel with fixed sampling: the average color of
+ * 'conf->pixel_samples' rays, placed by the sample pattern and the
+ * reconstruction filter. The rays are traced in packets.
+ *
+ * w_index: Horizontal position of the pixel in the image.
+ * h_index: Vertical position of the pixel in the image.
+ * conf: Configuration of the scene.
+ * state: Render state of the worker that is painting.
+ */
+Color get_fixed_pixel_color(int w_index, int h_index, const SceneConfig *conf, RenderState *state)
+{
+    Intersection inter_lists[PACKET_SIZE][MAX_NEAREST_INTERSECTIONS];
+    int inter_lengths[PACKET_SIZE];
+    RayPacket packet;
+    Coord2D sample;
+    Color sample_color, pixel_color;
+    int sample_i, lane;
+
+    pixel_color = (Color){ .red = 0.0, .green = 0.0, .blue = 0.0 };
+    packet.eye = conf->eye;
+    packet.length = 0;
+    for(sample_i = 0; sample_i < conf->pixel_samples; sample_i++)
     {
-        colors[0] = get_pixel_color(w_coord, h_coord, level+1, conf, current_row);
+        sample = get_pixel_sample(w_index, h_index, sample_i, conf->pixel_samples, conf->sample_pattern, conf->pixel_filter);
+        add_packet_ray(&packet, get_primary_ray(w_index + sample.u, h_index + sample.v, conf));
+        if(packet.length < PACKET_SIZE && sample_i + 1 < conf->pixel_samples) continue;
+        get_packet_nearest_intersections(&packet, conf->nearest_inters_length, inter_lists, inter_lengths, conf);
+        for(lane = 0; lane < packet.length; lane++)
+        {
+            sample_color = get_found_color(packet.eye, get_packet_ray(&packet, lane), inter_lists[lane], inter_lengths[lane], 0, conf);
+            pixel_color.red += sample_color.red;
+            pixel_color.green += sample_color.green;
+            pixel_color.blue += sample_color.blue;
+        }
+        state->rays_traced += packet.length;
+        packet.length = 0;
     }
-    if(are_colors_too_different(colors[1], avg_color))
+    pixel_color.red /= conf->pixel_samples;
+    pixel_color.green /= conf->pixel_samples;
+    pixel_color.blue /= conf->pixel_samples;
+    return pixel_color;
+}
+
+/*
+ * Paints a tile of the image into a block of the image writer. Rows inside the tile are
+ * painted from top to bottom, so the ray cache can reuse the bottom edge of a
+ * row as the top edge of the next one. The edges of the tile are taken from
+ * the tile borders when a neighbour tile already traced them. The pixel corners of each row are
+ * traced first in ray packets, and the pixels then take them from the cache.
+ * With fixed sampling every pixel traces its own samples instead.
+ *
+ * tile_index: Index of the tile. Tiles are numbered in row-major order.
+ * block: Block of the image writer where the pixels of the tile are stored.
+ * conf: Configuration of the scene.
+ * state: Render state of the worker that is painting.
+ */
+void paint_tile(int tile_index, ImageBlock *block, const SceneConfig *conf, RenderState *state)
+{
+    int w_index, h_index, w_begin, h_begin, w_end, h_end, tiles_per_row;
+    Color *row_pixels;
+
+    tiles_per_row = (conf->width_res + TILE_SIZE - 1) / TILE_SIZE;
+    w_begin = (tile_index % tiles_per_row) * TILE_SIZE;
+    h_begin = (tile_index / tiles_per_row) * TILE_SIZE;
+    w_end = w_begin + TILE_SIZE < conf->width_res ? w_begin + TILE_SIZE : conf->width_res;
+    h_end = h_begin + TILE_SIZE < conf->height_res ? h_begin + TILE_SIZE : conf->height_res;
+    block->w_begin = w_begin;
+    block->h_begin = h_begin;
+    block->width = w_end - w_begin;
+    block->height = h_end - h_begin;
+    start_cache_tile(&state->ray_cache, w_begin * conf->pixel_density);
+    for(h_index = h_begin; h_index < h_end; h_index++)
     {
-        colors[1] = get_pixel_color(w_coord + sub_pixel_diff, h_coord, level+1, conf, current_row);
+        // Blocks have TILE_SIZE pixels per row
+        row_pixels = &block->pixels[(h_index - h_begin) * TILE_SIZE];
+        if(conf->fixed_sampling)
+        {
+            for(w_index = w_begin; w_index < w_end; w_index++)
+                row_pixels[w_index - w_begin] = get_fixed_pixel_color(w_index, h_index, conf, state);
+            continue;
+        }
+        trace_corner_rays(h_index, w_begin, w_end, conf, state);
+        trace_corner_rays(h_index + 1, w_begin, w_end, conf, state);
+        for(w_index = w_begin; w_index < w_end; w_index++)
+        {
+            row_pixels[w_index - w_begin] = get_pixel_color(w_index, h_index, 1, conf, state);
+        }
     }
-    if(are_colors_too_different(colors[2], avg_color))
+}
+
+/*
+ * Adds a painted tile to the render progress, and prints the completed
+ * percentage when it changes. If the progress estimates the time, the
+ * remaining time is printed too, assuming the remaining tiles take as long as
+ * the painted ones.
+ *
+ * progress: Progress shared by all the workers.
+ */
+void report_tile_done(RenderProgress *progress)
+{
+    int new_percentage;
+    double elapsed_time;
+
+    pthread_mutex_lock(&progress->lock);
+    progress->tiles_done++;
+    new_percentage = (progress->tiles_done * 100) / progress->tiles_length;
+    if(new_percentage > progress->percentage)
     {
-        colors[2] = get_pixel_color(w_coord, h_coord + sub_pixel_diff, level+1, conf, current_row);
+        progress->percentage = new_percentage;
+        if(progress->estimates_time)
+        {
+            elapsed_time = difftime(time(NULL), progress->start_time);
+            printf("Percentage completed: %d, about %.0f seconds left\n", progress->percentage,
+                   elapsed_time * (progress->tiles_length - progress->tiles_done) / progress->tiles_done);
+        }
+        else printf("Percentage completed: %d\n", progress->percentage);
     }
-    if(are_colors_too_different(colors[3], avg_color))
+    pthread_mutex_unlock(&progress->lock);
+}
+
+/*
+ * Worker thread routine. Paints tiles until there are no more tiles left in
+ * the work queue.
+ *
+ * worker_ptr: Pointer to the RenderWorker struct of the thread.
+ */
+void* run_render_worker(void *worker_ptr)
+{
+    RenderWorker *worker = (RenderWorker*) worker_ptr;
+    ImageBlock *block;
+    int tile_index;
+
+    while((tile_index = get_work_item(worker->queue, worker->worker_index)) >= 0)
     {
-        colors[3] = get_pixel_color(w_coord + sub_pixel_diff, h_coord + sub_pixel_diff, level+1, conf, current_row);
+        block = take_image_block(worker->writer);
+        paint_tile(tile_index, block, worker->conf, &worker->state);
+        put_image_block(worker->writer, block);
+        report_tile_done(worker->progress);
     }
-    return get_avg_color(colors);
+    return NULL;
 }
 
 /*
@@ -173,39 +553,115 @@ Color get_pixel_color(long double w_coord, long double h_coord, int level, Scene
  * resolution of width_res * height_res. Scene environment and
  * objects should be initialized before calling this method, by calling the
  * 'load_scene' method.
+ * The image is split in tiles that are painted by 'conf->thread_count' workers.
+ * Every ray color only depends on its coordinates, so the image is the same
+ * no matter how many workers paint it. Each tile is written to the image as
+ * soon as it is painted, so the whole image is never kept in memory.
+ * Painting doesn't allocate any memory
+ * after the workers are created, and the allocations made while painting are
+ * reported to check it.
  *
  * conf: Configuration of the scene.
  */
-void paint_scene(SceneConfig conf)
+void paint_scene(const SceneConfig *conf)
 {
-	int w_index, h_index, current_row, new_percentage, percentage;
-	Color *image, *image_back_up;
+	int worker_i, tiles_length, level;
+	long rays_traced, rays_reused, rays_shared, subpixels_divided, subpixels_avoided;
+	unsigned long allocation_count;
+	ImageWriter writer;
+	WorkQueue queue;
+	RenderProgress progress;
+	TileBorders borders;
+	RenderWorker *workers;
+	pthread_t *threads;
 
-	image = get_memory(sizeof(Color) * conf.width_res * conf.height_res, NULL);
-	image_back_up = image;
-	current_row = percentage = new_percentage = 0;
-	// Calculate the color of each pixel of the framebuffer
-	for(h_index = 0; h_index < conf.height_res; h_index++)
-    {
-        for(w_index = 0; w_index < conf.width_res; w_index++)
-		{
-			*(image++) = get_pixel_color(w_index, h_index, 1, conf, current_row);
-		}
-		current_row++;
-		new_percentage = (current_row * 100) /conf.height_res;
-		if(new_percentage > percentage)
-        {
-            percentage = new_percentage;
-            printf("Percentage completed: %d\n", percentage);
-        }
-    }
-    create_image(image_back_up, conf.height_res, conf.width_res);
-    free(image_back_up);
+	// Twice as many blocks as workers, so the workers don't wait for the writer
+	open_image(&writer, conf->height_res, conf->width_res, TILE_SIZE, 2 * conf->thread_count);
+	tiles_length = ((conf->width_res + TILE_SIZE - 1) / TILE_SIZE) * ((conf->height_res + TILE_SIZE - 1) / TILE_SIZE);
+	queue = create_work_queue(conf->thread_count, tiles_length);
+	progress.tiles_length = tiles_length;
+	progress.tiles_done = progress.percentage = 0;
+	progress.estimates_time = conf->fixed_sampling;
+	pthread_mutex_init(&progress.lock, NULL);
+	if(!conf->fixed_sampling)
+	    borders = create_tile_borders(conf->width_res, conf->height_res, conf->pixel_density);
+	// Every worker shares the scene, and gets its own render state
+	workers = get_memory(sizeof(RenderWorker) * conf->thread_count, NULL);
+	threads = get_memory(sizeof(pthread_t) * conf->thread_count, NULL);
+	for(worker_i = 0; worker_i < conf->thread_count; worker_i++)
+	{
+	    workers[worker_i].conf = conf;
+	    workers[worker_i].state.ray_cache = create_ray_cache(conf->cache_size, conf->row_ray_count, conf->sparse_cache);
+	    workers[worker_i].state.borders = conf->fixed_sampling ? NULL : &borders;
+	    workers[worker_i].state.rays_traced = workers[worker_i].state.rays_reused = workers[worker_i].state.rays_shared = 0;
+	    workers[worker_i].state.subpixels_divided = get_memory(sizeof(long) * (conf->max_antialiase_level + 1), NULL);
+	    workers[worker_i].state.subpixels_avoided = get_memory(sizeof(long) * (conf->max_antialiase_level + 1), NULL);
+	    for(level = 0; level <= conf->max_antialiase_level; level++)
+	        workers[worker_i].state.subpixels_divided[level] = workers[worker_i].state.subpixels_avoided[level] = 0;
+	    workers[worker_i].worker_index = worker_i;
+	    workers[worker_i].queue = &queue;
+	    workers[worker_i].writer = &writer;
+	    workers[worker_i].progress = &progress;
+	}
+	printf("Ray packets: %s\n", init_ray_packets());
+	printf("Ray cache: %s, %d rays per thread\n", conf->sparse_cache ? "sparse" : "dense", conf->cache_size);
+	if(conf->fixed_sampling)
+	    printf("Fixed sampling: %d rays per pixel, %ld rays from the eye\n", conf->pixel_samples,
+	           (long) conf->pixel_samples * conf->width_res * conf->height_res);
+	progress.start_time = time(NULL);
+	// The calling thread works as the first worker
+	allocation_count = get_allocation_count();
+	for(worker_i = 1; worker_i < conf->thread_count; worker_i++)
+        pthread_create(&threads[worker_i], NULL, &run_render_worker, &workers[worker_i]);
+    run_render_worker(&workers[0]);
+	for(worker_i = 1; worker_i < conf->thread_count; worker_i++)
+        pthread_join(threads[worker_i], NULL);
+	printf("Allocations while painting: %lu\n", get_allocation_count() - allocation_count);
+	close_image(&writer);
+	rays_traced = rays_reused = rays_shared = 0;
+	for(worker_i = 0; worker_i < conf->thread_count; worker_i++)
+	{
+	    rays_traced += workers[worker_i].state.rays_traced;
+	    rays_reused += workers[worker_i].state.rays_reused;
+	    rays_shared += workers[worker_i].state.rays_shared;
+        destroy_ray_cache(&workers[worker_i].state.ray_cache);
+	}
+	printf("Rays traced: %ld, reused from cache: %ld, shared between tiles: %ld\n", rays_traced, rays_reused, rays_shared);
+	// The subpixels of the level 1 are the pixels, which are never avoided
+	for(level = 2; level <= conf->max_antialiase_level && !conf->fixed_sampling; level++)
+	{
+	    subpixels_divided = subpixels_avoided = 0;
+	    for(worker_i = 0; worker_i < conf->thread_count; worker_i++)
+	    {
+	        subpixels_divided += workers[worker_i].state.subpixels_divided[level];
+	        subpixels_avoided += workers[worker_i].state.subpixels_avoided[level];
+	    }
+	    printf("Antialiasing level %d: %ld subpixels painted, %ld avoided by the threshold\n",
+	           level, subpixels_divided, subpixels_avoided);
+	}
+	for(worker_i = 0; worker_i < conf->thread_count; worker_i++)
+	{
+	    free(workers[worker_i].state.subpixels_divided);
+	    free(workers[worker_i].state.subpixels_avoided);
+	}
+    pthread_mutex_destroy(&progress.lock);
+    if(!conf->fixed_sampling)
+        destroy_tile_borders(&borders);
+    destroy_work_queue(&queue);
+    free(threads);
+    free(workers);
 }
 
+/*
+ * Paints the scene described in 'scene.cfg'. The number of threads can be
+ * given as the first argument, which overrides the 'thread_count' of the
+ * configuration file.
+ */
 int main(int argc, char** argv)
 {
 	SceneConfig scene_config = load_scene("scene.cfg");
-	paint_scene(scene_config);
+	if(argc > 1 && atoi(argv[1]) > 0)
+        scene_config.thread_count = atoi(argv[1]);
+	paint_scene(&scene_config);
 	return 0;
 }
@@ -6,7 +6,10 @@
 #include "tracing/color.h"
 #include "tracing/object.h"
 #include "tracing/light.h"
-#include "tracing/cached_ray.h"
+#include "tracing/bvh.h"
+#include "tracing/figure_table.h"
+#include "tracing/color_difference.h"
+#include "tracing/pixel_sampler.h"
 
 /*
  * Holds all the high-level configuration of the scene that will be drawn.
@@ -14,44 +17,85 @@
  * window: Window through which the scene universe is seen. This will be mapped to the final image.
  * eye: Position of the eye in the scene. Rays are thrown from here to the window.
  * background: Color returned for a ray when no intersection was found.
+ * geometries: Figures that are shared by the instance objects. Only their figure and functions are loaded.
+ * geometries_length: Number of shared geometries.
  * objs: List of objects in the scene.
  * objs_length: Number of objects in the scene.
+ * objs_bvh: Bounding volume hierarchy over the bounded objects. It stores positions in 'objs'.
+ * unbounded_objs: Positions in 'objs' of the objects that can't be enclosed by a box (like planes).
+ *                 They are tested against every ray.
+ * unbounded_objs_length: Number of unbounded objects.
+ * objs_tables: Figures of the objects in the hierarchy, by figure type. Built over 'objs_bvh.indexes'.
+ * unbounded_tables: Figures of the unbounded objects, by figure type. Built over 'unbounded_objs'.
  * lights: List of lights in the scene.
  * lights_length: Number of lights in the scene.
  * environment_light: Color of the light that affects the whole scene.
  * max_mirror_level: Maximum number of reflections that can exist in an object intersection.
  * max_antialiase_level: Maximum number of pixel divisions that can exist for the adaptive antialiasing.
- * ray_cache: Cache for ray colors. The size of the cache increases dinamically according to the width of the image,
- *            and the maximum antialiasing level.
+ * antialiase_metric: Metric used to compare the corners of a pixel with its average color.
+ * antialiase_threshold: Difference (measured with 'antialiase_metric') above which a corner of a pixel is divided.
+ *                       With 0, the corners are divided whenever their color is not exactly the average.
+ * antialiase_geometry: True if the corners of a pixel are also divided when they hit a different object than
+ *                      another corner, or the same object with a normal too different.
+ * antialiase_normal_cos: Cosine of the largest angle between the normals of two corners that hit the same
+ *                        object, for which the corners are not divided.
+ * fixed_sampling: True if every pixel throws 'pixel_samples' rays, instead of using the adaptive antialiasing.
+ *                 The time needed to paint each pixel is then similar, so the remaining time can be estimated.
+ * pixel_samples: Number of rays thrown for each pixel with fixed sampling.
+ * sample_pattern: Pattern of the samples of each pixel with fixed sampling.
+ * pixel_filter: Reconstruction filter of the samples of each pixel with fixed sampling.
  * pixel_density: Number of subpixels that exist on a pixel. This is calculated according to the max_antialiase_level.
- * row_ray_count: Number of rays per PIXEL ROW. Note that this IS NOT the number of rays per image row. This is
- *                calculated according to the pixel_density and the width of the image.
- * cache_size: Size of the ray_cache.
- * current_row: Number of the image row that is being processed by the ray tracer. Used to optimize the ray cache.
+ * row_ray_count: Number of rays per PIXEL ROW of a tile. Note that this IS NOT the number of rays per image row.
+ *                This is calculated according to the pixel_density and the width of the tiles (see cached_ray.h).
+ * cache_size: Size of the ray cache of each worker, which holds the rays of a pixel row of a tile. It increases
+ *             according to the maximum antialiasing level, but not to the size of the image. It is never larger
+ *             than SPARSE_CACHE_SIZE (see cached_ray.h).
+ * sparse_cache: True if the ray cache is sparse. It is used when the dense cache would be larger than a sparse one.
  * max_transparency_level: Maximum number of objects that are considered for the color of a ray due to transparency.
+ * nearest_inters_length: Number of nearest intersections that are searched for every ray. It is 1 when there
+ *                        are not any transparent objects, otherwise max_transparency_level + 1.
  * width_res: Width resolution of the generated image.
  * height_res: Height resolution of the generated image.
+ * thread_count: Number of worker threads that paint the scene. Each worker has its own ray cache.
+ * optimize_scene: True if the scene optimizer runs after the scene is loaded (see scene_optimizer.c).
  */
 typedef struct
 {
 	Window window;
     Vector eye;
     Color background;
+    Object *geometries;
+    int geometries_length;
     Object *objs;
     int objs_length;
+    Bvh objs_bvh;
+    int *unbounded_objs;
+    int unbounded_objs_length;
+    FigureTables objs_tables;
+    FigureTables unbounded_tables;
     Light *lights;
     int lights_length;
     Color environment_light;
     int max_mirror_level ;
     int max_antialiase_level;
-    CachedRay *ray_cache;
+    ColorMetric antialiase_metric;
+    Real antialiase_threshold;
+    int antialiase_geometry;
+    Real antialiase_normal_cos;
+    int fixed_sampling;
+    int pixel_samples;
+    SamplePattern sample_pattern;
+    PixelFilter pixel_filter;
     int pixel_density;
     int row_ray_count;
     int cache_size;
-    int current_row;
+    int sparse_cache;
     int max_transparency_level;
+    int nearest_inters_length;
     int width_res;
     int height_res;
+    int thread_count;
+    int optimize_scene;
 } SceneConfig;
 
 #endif
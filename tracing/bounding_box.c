@@ -0,0 +1,152 @@
+/* bounding_box.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains the functions for axis aligned bounding boxes.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include "vector.h"
+#include "bounding_box.h"
+
+// Methods
+
+/*
+ * Returns a box that doesn't contain any point. Adding a point to it returns
+ * a box that only contains that point.
+ */
+BoundingBox get_empty_box()
+{
+    BoundingBox box;
+    box.min = (Vector){ .x = INFINITY, .y = INFINITY, .z = INFINITY };
+    box.max = (Vector){ .x = -INFINITY, .y = -INFINITY, .z = -INFINITY };
+    return box;
+}
+
+/*
+ * Returns the smallest box that contains the given box and point.
+ *
+ * box: Box that is being grown.
+ * point: Point that must be inside the returned box.
+ */
+BoundingBox add_point_to_box(BoundingBox box, Vector point)
+{
+    box.min.x = real_min(box.min.x, point.x);
+    box.min.y = real_min(box.min.y, point.y);
+    box.min.z = real_min(box.min.z, point.z);
+    box.max.x = real_max(box.max.x, point.x);
+    box.max.y = real_max(box.max.y, point.y);
+    box.max.z = real_max(box.max.z, point.z);
+    return box;
+}
+
+/*
+ * Returns the smallest box that contains both of the given boxes.
+ *
+ * box1: First box.
+ * box2: Second box.
+ */
+BoundingBox merge_boxes(BoundingBox box1, BoundingBox box2)
+{
+    return add_point_to_box(add_point_to_box(box1, box2.min), box2.max);
+}
+
+/*
+ * Grows a box the same amount on every direction.
+ *
+ * box: Box that is being grown.
+ * margin: Distance that is added to each side of the box.
+ */
+BoundingBox expand_box(BoundingBox box, Real margin)
+{
+    box.min = subtract_vectors(box.min, (Vector){ .x = margin, .y = margin, .z = margin });
+    box.max = get_ray_position(box.max, (Vector){ .x = 1.0, .y = 1.0, .z = 1.0 }, margin);
+    return box;
+}
+
+/*
+ * Returns true if the box doesn't contain any point.
+ *
+ * box: Box that is checked.
+ */
+int is_box_empty(BoundingBox box)
+{
+    return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+/*
+ * Returns the position in the middle of the box.
+ *
+ * box: Box for which the center is calculated.
+ */
+Vector get_box_center(BoundingBox box)
+{
+    return multiply_vector(0.5, get_ray_position(box.min, box.max, 1));
+}
+
+/*
+ * Returns the X (axis 0), Y (axis 1) or Z (axis 2) coordinate of a vector.
+ *
+ * vector: Vector from which the coordinate is taken.
+ * axis: Axis of the coordinate.
+ */
+Real get_box_axis_value(Vector vector, int axis)
+{
+    if(axis == 0) return vector.x;
+    else if(axis == 1) return vector.y;
+    else return vector.z;
+}
+
+/*
+ * Returns the inverse of each coordinate of a ray direction. It is calculated
+ * once per ray, so the box tests don't need any divisions. Zero coordinates
+ * are inverted to the largest value instead of infinity, so the box tests
+ * never multiply zero by infinity.
+ *
+ * dir_vec: Direction of the ray.
+ */
+Vector get_inverse_direction(Vector dir_vec)
+{
+    Vector inv_dir_vec;
+    inv_dir_vec.x = dir_vec.x ? 1.0 / dir_vec.x : REAL_MAX;
+    inv_dir_vec.y = dir_vec.y ? 1.0 / dir_vec.y : REAL_MAX;
+    inv_dir_vec.z = dir_vec.z ? 1.0 / dir_vec.z : REAL_MAX;
+    return inv_dir_vec;
+}
+
+/*
+ * Returns true if a ray goes through a box before traveling 'max_distance'.
+ * It also returns the distance at which the ray enters the box (0 if the ray
+ * starts inside the box).
+ *
+ * box: Box that is being tested.
+ * eye: Position from which the ray is thrown.
+ * inv_dir_vec: Inverse of the ray direction (see 'get_inverse_direction').
+ * max_distance: Maximum distance that the ray travels.
+ * distance: Output parameter for the distance at which the ray enters the box.
+ *           It can be NULL.
+ */
+int is_box_hit(BoundingBox box, Vector eye, Vector inv_dir_vec, Real max_distance, Real *distance)
+{
+    Real t1, t2, t_near, t_far;
+
+    t_near = 0.0;
+    t_far = max_distance;
+    t1 = (box.min.x - eye.x) * inv_dir_vec.x;
+    t2 = (box.max.x - eye.x) * inv_dir_vec.x;
+    t_near = real_max(t_near, real_min(t1, t2));
+    t_far = real_min(t_far, real_max(t1, t2));
+    t1 = (box.min.y - eye.y) * inv_dir_vec.y;
+    t2 = (box.max.y - eye.y) * inv_dir_vec.y;
+    t_near = real_max(t_near, real_min(t1, t2));
+    t_far = real_min(t_far, real_max(t1, t2));
+    t1 = (box.min.z - eye.z) * inv_dir_vec.z;
+    t2 = (box.max.z - eye.z) * inv_dir_vec.z;
+    t_near = real_max(t_near, real_min(t1, t2));
+    t_far = real_min(t_far, real_max(t1, t2));
+    if(distance) *distance = t_near;
+    return t_near <= t_far;
+}
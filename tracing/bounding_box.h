@@ -0,0 +1,28 @@
+#ifndef BOUNDING_BOX_H
+#define BOUNDING_BOX_H
+
+#include "vector.h"
+
+/*
+ * Represents an axis aligned box that encloses a figure or a group of figures.
+ *
+ * min: Corner of the box with the lowest X, Y and Z coordinates.
+ * max: Corner of the box with the highest X, Y and Z coordinates.
+ */
+typedef struct
+{
+	Vector min;
+	Vector max;
+} BoundingBox;
+
+BoundingBox get_empty_box();
+BoundingBox add_point_to_box(BoundingBox box, Vector point);
+BoundingBox merge_boxes(BoundingBox box1, BoundingBox box2);
+BoundingBox expand_box(BoundingBox box, Real margin);
+int is_box_empty(BoundingBox box);
+Vector get_box_center(BoundingBox box);
+Real get_box_axis_value(Vector vector, int axis);
+Vector get_inverse_direction(Vector dir_vec);
+int is_box_hit(BoundingBox box, Vector eye, Vector inv_dir_vec, Real max_distance, Real *distance);
+
+#endif
@@ -0,0 +1,158 @@
+/* bvh.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Builds bounding volume hierarchies, used to reduce the number of figures
+ * that are tested against each ray.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../utilities/memory_handler.h"
+#include "vector.h"
+#include "bounding_box.h"
+#include "bvh.h"
+
+// Methods
+
+/*
+ * Reorders the indexes between 'beg' and 'end' (not included), so the item
+ * in the 'nth' position is the one that would be there if the list were
+ * ordered by the center of the boxes on the given axis. Items before 'nth'
+ * have a lower or equal center, and items after have a higher or equal center.
+ *
+ * indexes: Indexes of the boxes that are being reordered.
+ * centers: Center of each box.
+ * beg: First position of the range.
+ * end: Position after the last one of the range.
+ * nth: Position that must hold its ordered item.
+ * axis: Axis used to compare the boxes.
+ */
+void select_nth_center(int *indexes, Vector *centers, int beg, int end, int nth, int axis)
+{
+    int l, r, temp;
+    Real piv;
+
+    while(end - beg > 1)
+    {
+        piv = get_box_axis_value(centers[indexes[(beg + end) / 2]], axis);
+        l = beg;
+        r = end - 1;
+        while(l <= r)
+        {
+            while(get_box_axis_value(centers[indexes[l]], axis) < piv) l++;
+            while(get_box_axis_value(centers[indexes[r]], axis) > piv) r--;
+            if(l <= r)
+            {
+                temp = indexes[l];
+                indexes[l++] = indexes[r];
+                indexes[r--] = temp;
+            }
+        }
+        if(nth <= r) end = r + 1;
+        else if(nth >= l) beg = l;
+        else return;
+    }
+}
+
+/*
+ * Builds the node that encloses the items between 'beg' and 'end' (not
+ * included), and all the nodes below it. Returns the position of the node.
+ *
+ * bvh: Hierarchy that is being built.
+ * boxes: Boxes of all the items.
+ * centers: Center of each box.
+ * beg: First position of the items in 'bvh->indexes'.
+ * end: Position after the last item in 'bvh->indexes'.
+ */
+int build_bvh_node(Bvh *bvh, BoundingBox *boxes, Vector *centers, int beg, int end)
+{
+    BvhNode *node;
+    BoundingBox center_box;
+    Vector extent;
+    int node_i, item_i, axis, middle;
+
+    node_i = bvh->nodes_length++;
+    node = &bvh->nodes[node_i];
+    node->box = get_empty_box();
+    center_box = get_empty_box();
+    for(item_i = beg; item_i < end; item_i++)
+    {
+        node->box = merge_boxes(node->box, boxes[bvh->indexes[item_i]]);
+        center_box = add_point_to_box(center_box, centers[bvh->indexes[item_i]]);
+    }
+    // Small groups (or groups that can't be split) become leaves
+    extent = subtract_vectors(center_box.max, center_box.min);
+    if(end - beg <= BVH_LEAF_SIZE || (extent.x == 0 && extent.y == 0 && extent.z == 0))
+    {
+        node->first = beg;
+        node->length = end - beg;
+        node->right_child = 0;
+        return node_i;
+    }
+    // Split the items by the median center on the axis with the largest spread
+    if(extent.x >= extent.y && extent.x >= extent.z) axis = 0;
+    else if(extent.y >= extent.z) axis = 1;
+    else axis = 2;
+    middle = (beg + end) / 2;
+    select_nth_center(bvh->indexes, centers, beg, end, middle, axis);
+    node->first = 0;
+    node->length = 0;
+    build_bvh_node(bvh, boxes, centers, beg, middle);
+    node->right_child = build_bvh_node(bvh, boxes, centers, middle, end);
+    return node_i;
+}
+
+/*
+ * Builds a bounding volume hierarchy over a list of boxes. The hierarchy
+ * stores the position of each box in the given list.
+ *
+ * boxes: Boxes that enclose each item.
+ * boxes_length: Number of boxes.
+ */
+Bvh build_bvh(BoundingBox *boxes, int boxes_length)
+{
+    Bvh bvh;
+    BvhNode *nodes;
+    Vector *centers;
+    int box_i;
+
+    bvh.nodes_length = 0;
+    bvh.indexes_length = boxes_length;
+    if(!boxes_length)
+    {
+        bvh.nodes = NULL;
+        bvh.indexes = NULL;
+        return bvh;
+    }
+    // A binary tree with at least one item per leaf has less than 2n nodes
+    bvh.nodes = get_memory(sizeof(BvhNode) * (2 * boxes_length - 1), NULL);
+    bvh.indexes = get_memory(sizeof(int) * boxes_length, NULL);
+    centers = get_memory(sizeof(Vector) * boxes_length, NULL);
+    for(box_i = 0; box_i < boxes_length; box_i++)
+    {
+        bvh.indexes[box_i] = box_i;
+        centers[box_i] = get_box_center(boxes[box_i]);
+    }
+    build_bvh_node(&bvh, boxes, centers, 0, boxes_length);
+    free(centers);
+    // Leaves hold several items, so most of the nodes are not used
+    nodes = realloc(bvh.nodes, sizeof(BvhNode) * bvh.nodes_length);
+    if(nodes) bvh.nodes = nodes;
+    return bvh;
+}
+
+/*
+ * Frees the memory used by a hierarchy.
+ *
+ * bvh: Hierarchy that will be destroyed.
+ */
+void destroy_bvh(Bvh *bvh)
+{
+    free(bvh->nodes);
+    free(bvh->indexes);
+    bvh->nodes = NULL;
+    bvh->indexes = NULL;
+    bvh->nodes_length = bvh->indexes_length = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "bounding_box.h"
+
+// Maximum number of items that are stored on a leaf of the hierarchy.
+#define BVH_LEAF_SIZE 4
+// Maximum depth of the hierarchy. Used for the traversal stacks.
+#define BVH_MAX_DEPTH 64
+
+/*
+ * Represents a node of a bounding volume hierarchy. Nodes are stored in depth
+ * first order, so the left child of a node is always the next node.
+ *
+ * box: Box that encloses every item below the node.
+ * first: Position in the 'indexes' list of the hierarchy where the items of
+ *        the leaf begin. Unused for inner nodes.
+ * length: Number of items on the leaf. It is 0 for inner nodes.
+ * right_child: Position of the right child of an inner node.
+ */
+typedef struct
+{
+	BoundingBox box;
+	int first;
+	int length;
+	int right_child;
+} BvhNode;
+
+/*
+ * Represents a bounding volume hierarchy (BVH) over a list of boxes. It is
+ * used to discard groups of items that can't be hit by a ray.
+ *
+ * nodes: Nodes of the hierarchy. The first node is the root.
+ * nodes_length: Number of nodes. It is 0 if the hierarchy is empty.
+ * indexes: Positions of the items in the original list, ordered by leaf.
+ * indexes_length: Number of items in the hierarchy.
+ */
+typedef struct
+{
+	BvhNode *nodes;
+	int nodes_length;
+	int *indexes;
+	int indexes_length;
+} Bvh;
+
+Bvh build_bvh(BoundingBox *boxes, int boxes_length);
+void destroy_bvh(Bvh *bvh);
+
+#endif
@@ -0,0 +1,236 @@
+/* cached_ray.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains the functions that manage the cache of thrown rays, and the rays
+ * shared between tiles.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include "../utilities/memory_handler.h"
+#include "cached_ray.h"
+
+// States of a shared ray
+#define SHARED_RAY_EMPTY 0
+#define SHARED_RAY_WRITING 1
+#define SHARED_RAY_READY 2
+
+// Methods
+
+/*
+ * Creates an empty ray cache. Every worker that paints the scene needs its own
+ * cache, which holds the rays of the pixel row of the tile it is painting.
+ *
+ * cache_size: Number of rays that the cache can hold. It must be a power of two for sparse caches.
+ * row_ray_count: Number of rays of a lattice row of a tile (see SceneConfig).
+ * sparse: True if the cache is sparse.
+ */
+RayCache create_ray_cache(int cache_size, int row_ray_count, int sparse)
+{
+    RayCache cache;
+    int cache_i;
+
+    cache.rays = get_memory(sizeof(CachedRay) * cache_size, NULL);
+    cache.stamps = NULL;
+    cache.size = cache_size;
+    cache.row_length = row_ray_count;
+    cache.row_count = cache_size / row_ray_count;
+    cache.tile_lattice_w = 0;
+    cache.stamp = 0;
+    for(cache_i = 0; cache_i < cache_size; cache_i++)
+        cache.rays[cache_i].lattice_w = cache.rays[cache_i].lattice_h = -1;
+    if(sparse)
+    {
+        cache.stamps = get_memory(sizeof(long) * cache_size, NULL);
+        for(cache_i = 0; cache_i < cache_size; cache_i++)
+            cache.stamps[cache_i] = 0;
+    }
+    return cache;
+}
+
+/*
+ * Frees the memory used by a ray cache.
+ *
+ * cache: Ray cache that will be destroyed.
+ */
+void destroy_ray_cache(RayCache *cache)
+{
+    free(cache->rays);
+    free(cache->stamps);
+}
+
+/*
+ * Prepares a ray cache for the tile being painted.
+ *
+ * cache: Ray cache of the worker.
+ * tile_lattice_w: Horizontal position in the lattice of the tile.
+ */
+void start_cache_tile(RayCache *cache, int tile_lattice_w)
+{
+    cache->tile_lattice_w = tile_lattice_w;
+}
+
+/*
+ * Returns the first entry of a sparse ray cache where a lattice point may be
+ * stored. The next SPARSE_CACHE_PROBES - 1 entries may hold it too.
+ *
+ * cache: Sparse ray cache.
+ * lattice_w: Horizontal position of the point in the lattice.
+ * lattice_h: Vertical position of the point in the lattice.
+ */
+int get_sparse_cache_index(const RayCache *cache, int lattice_w, int lattice_h)
+{
+    return (((unsigned int) lattice_w * 73856093u) ^ ((unsigned int) lattice_h * 19349663u)) & (cache->size - 1);
+}
+
+/*
+ * Copies the ray of a lattice point from a ray cache. Returns false if the ray
+ * is not cached.
+ *
+ * cache: Ray cache of the worker.
+ * lattice_w: Horizontal position of the point in the lattice.
+ * lattice_h: Vertical position of the point in the lattice.
+ * ray: Output parameter for the ray.
+ */
+int get_cached_ray(const RayCache *cache, int lattice_w, int lattice_h, CachedRay *ray)
+{
+    const CachedRay *entry;
+    int cache_index, probe_i;
+
+    if(cache->stamps == NULL)
+    {
+        // The dense cache holds the lattice rows of a pixel row, and every entry knows its lattice point
+        entry = &cache->rays[(lattice_h % cache->row_count) * cache->row_length + lattice_w - cache->tile_lattice_w];
+        if(entry->lattice_w != lattice_w || entry->lattice_h != lattice_h) return 0;
+        *ray = *entry;
+        return 1;
+    }
+    cache_index = get_sparse_cache_index(cache, lattice_w, lattice_h);
+    for(probe_i = 0; probe_i < SPARSE_CACHE_PROBES; probe_i++)
+    {
+        entry = &cache->rays[(cache_index + probe_i) & (cache->size - 1)];
+        if(entry->lattice_w == lattice_w && entry->lattice_h == lattice_h)
+        {
+            *ray = *entry;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Stores a ray in a ray cache. A sparse cache stores it in the oldest of its
+ * entries, which may be empty.
+ *
+ * cache: Ray cache of the worker.
+ * ray: Ray that is stored. It must know its lattice point.
+ */
+void add_cached_ray(RayCache *cache, const CachedRay *ray)
+{
+    int cache_index, oldest_index, probe_i;
+
+    if(cache->stamps == NULL)
+    {
+        cache->rays[(ray->lattice_h % cache->row_count) * cache->row_length + ray->lattice_w - cache->tile_lattice_w] = *ray;
+        return;
+    }
+    cache_index = oldest_index = get_sparse_cache_index(cache, ray->lattice_w, ray->lattice_h);
+    for(probe_i = 1; probe_i < SPARSE_CACHE_PROBES; probe_i++)
+    {
+        cache_index = (cache_index + 1) & (cache->size - 1);
+        if(cache->stamps[cache_index] < cache->stamps[oldest_index]) oldest_index = cache_index;
+    }
+    cache->rays[oldest_index] = *ray;
+    cache->stamps[oldest_index] = ++cache->stamp;
+}
+
+/*
+ * Creates the empty shared rays of the borders between the tiles of an image.
+ *
+ * width_res: Width of the image, in pixels.
+ * height_res: Height of the image, in pixels.
+ * pixel_density: Number of lattice points per pixel on each axis.
+ */
+TileBorders create_tile_borders(int width_res, int height_res, int pixel_density)
+{
+    TileBorders borders;
+    int rows_length, columns_length, ray_i;
+
+    borders.share_step = pixel_density > BORDER_DENSITY ? pixel_density / BORDER_DENSITY : 1;
+    borders.lattice_width = width_res * (pixel_density / borders.share_step) + 1;
+    borders.lattice_height = height_res * (pixel_density / borders.share_step) + 1;
+    borders.border_step = TILE_SIZE * pixel_density;
+    // The edges of the image are counted as borders, so every border is found the same way
+    rows_length = (height_res / TILE_SIZE + 1) * borders.lattice_width;
+    columns_length = (width_res / TILE_SIZE + 1) * borders.lattice_height;
+    borders.row_rays = get_memory(sizeof(SharedRay) * rows_length, NULL);
+    borders.column_rays = get_memory(sizeof(SharedRay) * columns_length, NULL);
+    for(ray_i = 0; ray_i < rows_length; ray_i++)
+        borders.row_rays[ray_i].state = SHARED_RAY_EMPTY;
+    for(ray_i = 0; ray_i < columns_length; ray_i++)
+        borders.column_rays[ray_i].state = SHARED_RAY_EMPTY;
+    return borders;
+}
+
+/*
+ * Frees the memory used by the shared rays of the tile borders.
+ *
+ * borders: Tile borders that will be destroyed.
+ */
+void destroy_tile_borders(TileBorders *borders)
+{
+    free(borders->row_rays);
+    free(borders->column_rays);
+}
+
+/*
+ * Returns the shared ray of a lattice point, or NULL if the point is not on a
+ * border between tiles, or it is not shared.
+ *
+ * borders: Shared rays of the tile borders.
+ * lattice_w: Horizontal position of the point in the lattice.
+ * lattice_h: Vertical position of the point in the lattice.
+ */
+SharedRay* find_border_ray(const TileBorders *borders, int lattice_w, int lattice_h)
+{
+    if(lattice_w % borders->share_step != 0 || lattice_h % borders->share_step != 0) return NULL;
+    if(lattice_h % borders->border_step == 0)
+        return &borders->row_rays[(lattice_h / borders->border_step) * borders->lattice_width +
+                                  lattice_w / borders->share_step];
+    if(lattice_w % borders->border_step == 0)
+        return &borders->column_rays[(lattice_w / borders->border_step) * borders->lattice_height +
+                                     lattice_h / borders->share_step];
+    return NULL;
+}
+
+/*
+ * Copies a shared ray, if another worker has already shared it. Returns false
+ * if the ray is not ready yet.
+ *
+ * shared_ray: Shared ray that is read.
+ * ray: Output parameter for the ray.
+ */
+int get_shared_ray(SharedRay *shared_ray, CachedRay *ray)
+{
+    // The atomic read keeps the ray from being read before its state
+    if(__sync_fetch_and_add(&shared_ray->state, 0) != SHARED_RAY_READY) return 0;
+    *ray = shared_ray->ray;
+    return 1;
+}
+
+/*
+ * Shares a traced ray with the other workers. If another worker is already
+ * sharing it, nothing is done: the ray color only depends on its lattice
+ * point, so both of them traced the same ray.
+ *
+ * shared_ray: Shared ray where the ray is stored.
+ * ray: Ray that is shared.
+ */
+void share_ray(SharedRay *shared_ray, const CachedRay *ray)
+{
+    if(!__sync_bool_compare_and_swap(&shared_ray->state, SHARED_RAY_EMPTY, SHARED_RAY_WRITING)) return;
+    shared_ray->ray = *ray;
+    // The ray is stored before the state changes, the swap is a full barrier
+    __sync_bool_compare_and_swap(&shared_ray->state, SHARED_RAY_WRITING, SHARED_RAY_READY);
+}
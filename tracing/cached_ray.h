@@ -2,17 +2,115 @@
 #define CACHED_RAY_H
 
 #include "color.h"
+#include "vector.h"
+#include "object.h"
+
+// Width and height, in pixels, of the tiles in which the image is painted
+#define TILE_SIZE 32
+// Number of rays of a sparse ray cache, used when the dense one would be larger
+#define SPARSE_CACHE_SIZE 16384
+// Number of entries of a sparse ray cache where a ray may be stored
+#define SPARSE_CACHE_PROBES 8
+// Maximum number of lattice points per pixel, on each axis, that are shared on the tile borders
+#define BORDER_DENSITY 2
 
 /*
- * Represents a thrown ray color.
+ * Represents a thrown ray color, and what the ray hit first. The geometry is
+ * used by the antialiasing to find the edges of the objects. Rays are thrown
+ * towards the points of a lattice over the image, with 'pixel_density'
+ * points per pixel on each axis (see SceneConfig), and the ray is known by
+ * its lattice point.
  *
  * color: Color that returned the ray.
- * row: Row to which the ray belongs.
+ * obj: Nearest object hit by the ray. It is NULL if the ray hit nothing.
+ * normal: Normal vector of 'obj' where the ray hit it. It is only set when the
+ *         antialiasing uses the geometry (see 'antialiase_geometry' in SceneConfig).
+ * lattice_w: Horizontal position of the ray in the lattice. It is -1 for empty cache entries.
+ * lattice_h: Vertical position of the ray in the lattice.
  */
 typedef struct
 {
 	Color color;
-	int row;
+	const Object *obj;
+	Vector normal;
+	int lattice_w;
+	int lattice_h;
 } CachedRay;
 
+/*
+ * Represents the cache of the rays of a worker. The cache is dense at low
+ * antialiasing levels, with an entry for each lattice point of the pixel row
+ * of the tile being painted. At high levels the adaptive antialiasing only
+ * takes a few of those rays, so the cache is sparse: the rays are spread over
+ * a hash table with open addressing, and a new ray replaces the oldest one of
+ * its entries. The rays of a pixel are taken one after the other, so the
+ * newest rays are the ones that are reused.
+ *
+ * rays: Entries of the cache.
+ * stamps: Only for sparse caches. Order in which each entry was stored, 0 for empty entries.
+ * size: Number of entries of the cache.
+ * row_length: Only for dense caches. Number of entries for each lattice row.
+ * row_count: Only for dense caches. Number of lattice rows held by the cache.
+ * tile_lattice_w: Only for dense caches. Horizontal position in the lattice of the tile being painted.
+ * stamp: Only for sparse caches. Number of rays stored so far.
+ */
+typedef struct
+{
+	CachedRay *rays;
+	long *stamps;
+	int size;
+	int row_length;
+	int row_count;
+	int tile_lattice_w;
+	long stamp;
+} RayCache;
+
+/*
+ * Represents a ray that may be shared by several workers.
+ *
+ * ray: Shared ray. It can only be read once 'state' is SHARED_RAY_READY.
+ * state: SHARED_RAY_EMPTY, SHARED_RAY_WRITING (a worker is storing the ray) or SHARED_RAY_READY.
+ */
+typedef struct
+{
+	CachedRay ray;
+	int state;
+} SharedRay;
+
+/*
+ * Holds the rays on the borders between the tiles, which are needed by the
+ * tiles on both sides. The worker that traces one of them first shares it
+ * with the others, without locks. The lattice points on the crossings of the
+ * borders are stored with the horizontal borders. At high antialiasing levels
+ * only BORDER_DENSITY points per pixel are shared, so the borders don't grow
+ * with the level.
+ *
+ * row_rays: Rays on the horizontal borders (every TILE_SIZE pixel rows), one border after the other.
+ * column_rays: Rays on the vertical borders (every TILE_SIZE pixel columns), one border after the other.
+ * lattice_width: Number of shared points on a horizontal border.
+ * lattice_height: Number of shared points on a vertical border.
+ * border_step: Distance between two borders, in lattice points.
+ * share_step: Distance between two shared points of a border, in lattice points.
+ */
+typedef struct
+{
+	SharedRay *row_rays;
+	SharedRay *column_rays;
+	int lattice_width;
+	int lattice_height;
+	int border_step;
+	int share_step;
+} TileBorders;
+
+RayCache create_ray_cache(int cache_size, int row_ray_count, int sparse);
+void destroy_ray_cache(RayCache *cache);
+void start_cache_tile(RayCache *cache, int tile_lattice_w);
+int get_cached_ray(const RayCache *cache, int lattice_w, int lattice_h, CachedRay *ray);
+void add_cached_ray(RayCache *cache, const CachedRay *ray);
+TileBorders create_tile_borders(int width_res, int height_res, int pixel_density);
+void destroy_tile_borders(TileBorders *borders);
+SharedRay* find_border_ray(const TileBorders *borders, int lattice_w, int lattice_h);
+int get_shared_ray(SharedRay *shared_ray, CachedRay *ray);
+void share_ray(SharedRay *shared_ray, const CachedRay *ray);
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef COLOR_H
 #define COLOR_H
 
+#include "real.h"
+
 /*
  * Represents an RGB color.
  *
@@ -10,9 +12,9 @@
  */
 typedef struct
 {
-	long double red;
-	long double green;
-	long double blue;
+	Real red;
+	Real green;
+	Real blue;
 } Color;
 
 #endif
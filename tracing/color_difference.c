@@ -0,0 +1,118 @@
+/* color_difference.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Measures how different two colors are, so the antialiasing only divides
+ * the pixels whose corners look different.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "color.h"
+#include "color_difference.h"
+
+// Luminance below which the luminance contrast is measured as if it were this one,
+// so the noise of dark colors isn't taken as a large contrast
+#define LUMINANCE_FLOOR 0.05
+
+/*
+ * Represents a color in the CIE L*a*b* space.
+ *
+ * lightness: L* value, from 0 (black) to 100 (white).
+ * green_red: a* value, negative towards green and positive towards red.
+ * blue_yellow: b* value, negative towards blue and positive towards yellow.
+ */
+typedef struct
+{
+    Real lightness;
+    Real green_red;
+    Real blue_yellow;
+} LabColor;
+
+// Methods
+
+/*
+ * Returns the luminance of a color, with the Rec. 709 weights.
+ *
+ * color: Color whose luminance is calculated.
+ */
+Real get_luminance(Color color)
+{
+    return 0.2126 * color.red + 0.7152 * color.green + 0.0722 * color.blue;
+}
+
+/*
+ * Returns the linear value of a channel of a color, once it is written to the
+ * image as an 8 bit sRGB value.
+ *
+ * value: Value of the channel, between 0 and 1.
+ */
+Real get_linear_channel(Real value)
+{
+    value = real_round(255 * value) / 255.0;
+    if(value <= 0.04045) return value / 12.92;
+    return real_pow((value + 0.055) / 1.055, 2.4);
+}
+
+/*
+ * Returns the L*a*b* function of a coordinate of the XYZ space, relative to
+ * the white point.
+ *
+ * value: Relative coordinate.
+ */
+Real get_lab_function(Real value)
+{
+    if(value > 216.0 / 24389.0) return real_cbrt(value);
+    return value * 24389.0 / 3132.0 + 4.0 / 29.0;
+}
+
+/*
+ * Returns a color in the L*a*b* space, once it is written to the image as an 8
+ * bit sRGB color (D65 white point).
+ *
+ * color: Color that is converted.
+ */
+LabColor get_lab_color(Color color)
+{
+    Real red, green, blue, x, y, z;
+
+    red = get_linear_channel(color.red);
+    green = get_linear_channel(color.green);
+    blue = get_linear_channel(color.blue);
+    x = get_lab_function((0.4124 * red + 0.3576 * green + 0.1805 * blue) / 0.95047);
+    y = get_lab_function(0.2126 * red + 0.7152 * green + 0.0722 * blue);
+    z = get_lab_function((0.0193 * red + 0.1192 * green + 0.9505 * blue) / 1.08883);
+    return (LabColor){ .lightness = 116 * y - 16, .green_red = 500 * (x - y), .blue_yellow = 200 * (y - z) };
+}
+
+/*
+ * Returns how different two colors are, measured with the given metric. Equal
+ * colors always have a difference of 0.
+ *
+ * color1: First color that will be compared.
+ * color2: Second color that will be compared.
+ * metric: Metric used to measure the difference.
+ */
+Real get_color_difference(Color color1, Color color2, ColorMetric metric)
+{
+    LabColor lab1, lab2;
+    Real luminance1, luminance2;
+
+    switch(metric)
+    {
+    case COLOR_METRIC_LUMINANCE:
+        luminance1 = get_luminance(color1);
+        luminance2 = get_luminance(color2);
+        return real_abs(luminance1 - luminance2) / real_max(real_max(luminance1, luminance2), LUMINANCE_FLOOR);
+    case COLOR_METRIC_DELTA_E:
+        lab1 = get_lab_color(color1);
+        lab2 = get_lab_color(color2);
+        return real_sqrt((lab1.lightness - lab2.lightness) * (lab1.lightness - lab2.lightness) +
+                         (lab1.green_red - lab2.green_red) * (lab1.green_red - lab2.green_red) +
+                         (lab1.blue_yellow - lab2.blue_yellow) * (lab1.blue_yellow - lab2.blue_yellow));
+    default:
+        return real_max(real_abs(color1.red - color2.red),
+                        real_max(real_abs(color1.green - color2.green), real_abs(color1.blue - color2.blue)));
+    }
+}
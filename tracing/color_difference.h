@@ -0,0 +1,22 @@
+#ifndef COLOR_DIFFERENCE_H
+#define COLOR_DIFFERENCE_H
+
+#include "color.h"
+
+/*
+ * Ways of measuring how different two colors are:
+ *      - COLOR_METRIC_CHANNEL: Largest difference of the red, green and blue values (0 to 1).
+ *      - COLOR_METRIC_LUMINANCE: Difference of luminance, relative to the brightest color (0 to 1).
+ *      - COLOR_METRIC_DELTA_E: CIE76 difference (Delta E) of the 8 bit colors written to the image.
+ *                              Differences below 2.3 are barely noticeable.
+ */
+typedef enum
+{
+    COLOR_METRIC_CHANNEL,
+    COLOR_METRIC_LUMINANCE,
+    COLOR_METRIC_DELTA_E
+} ColorMetric;
+
+Real get_color_difference(Color color1, Color color2, ColorMetric metric);
+
+#endif
@@ -0,0 +1,138 @@
+/* figure.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Calls the functions of the figure of an object according to its type. The
+ * calls are direct, so the processor can predict them, and the compiler can
+ * inline them when the program is linked with '-flto'.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include "vector.h"
+#include "object.h"
+#include "bounding_box.h"
+#include "figure.h"
+#include "../figures/sphere.h"
+#include "../figures/plane.h"
+#include "../figures/polygon.h"
+#include "../figures/disc.h"
+#include "../figures/cylinder.h"
+#include "../figures/cone.h"
+#include "../figures/mesh.h"
+#include "../figures/instance.h"
+#include "../figures/heightfield.h"
+#include "../figures/particles.h"
+
+// Switch cases for each figure function
+#define INTERSECTION_CASE(type, name) case FIGURE_##type: return get_##name##_intersection(eye, dir_vec, obj, inter_list);
+#define NORMAL_VECTOR_CASE(type, name) case FIGURE_##type: return get_##name##_normal_vector(posn, obj->figure, primitive);
+#define BOUNDS_CASE(type, name) case FIGURE_##type: return get_##name##_bounds(obj->figure, box);
+
+// Methods
+
+/*
+ * Finds the intersections between the figure of an object and a ray. Returns
+ * the number of intersections found.
+ *
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * obj: Object whose figure is intersected.
+ * inter_list: Output list (of Intersection structs) with space for
+ *             MAX_FIGURE_INTERSECTIONS intersections.
+ */
+int get_figure_intersections(Vector eye, Vector dir_vec, Object *obj, void *inter_list)
+{
+    switch(obj->type)
+    {
+    FIGURE_TYPE_LIST(INTERSECTION_CASE)
+    }
+    return 0;
+}
+
+/*
+ * Returns the normal vector of the figure of an object on a given position.
+ * The vector is already normalized.
+ *
+ * posn: Position at which the normal is calculated.
+ * obj: Object whose figure is used.
+ * primitive: Primitive of the figure where the position is (see Intersection).
+ */
+Vector get_figure_normal_vector(Vector posn, Object *obj, int primitive)
+{
+    switch(obj->type)
+    {
+    FIGURE_TYPE_LIST(NORMAL_VECTOR_CASE)
+    }
+    return posn;
+}
+
+/*
+ * Calculates the box that encloses the figure of an object. Returns false if
+ * the figure is unbounded.
+ *
+ * obj: Object whose figure is enclosed.
+ * box: Output parameter for the box of the figure.
+ */
+int get_figure_bounds(Object *obj, BoundingBox *box)
+{
+    switch(obj->type)
+    {
+    FIGURE_TYPE_LIST(BOUNDS_CASE)
+    }
+    return 0;
+}
+
+/*
+ * Returns the color of the figure of an object on one of its primitives.
+ * Particle clouds may give a color to each particle, every other figure has
+ * the color of its object.
+ *
+ * obj: Object whose figure is used.
+ * primitive: Primitive of the figure (see Intersection).
+ */
+Color get_figure_color(Object *obj, int primitive)
+{
+    Object *shape;
+    switch(obj->type)
+    {
+    case FIGURE_PARTICLES:
+        return get_particle_color((ParticleCloud*) obj->figure, primitive, obj->color);
+    case FIGURE_INSTANCE:
+        // Instances are flattened when loaded, so their shape is never an instance
+        shape = &((Instance*) obj->figure)->shape;
+        if(shape->type == FIGURE_PARTICLES) return get_particle_color((ParticleCloud*) shape->figure, primitive, obj->color);
+        return obj->color;
+    default:
+        return obj->color;
+    }
+}
+
+/*
+ * Frees the memory used by the figure of an object. The figure of an
+ * instance belongs to its geometry, so only the instance is freed.
+ *
+ * obj: Object whose figure is destroyed. Its figure is set to NULL.
+ */
+void destroy_figure(Object *obj)
+{
+    switch(obj->type)
+    {
+    case FIGURE_POLYGON:
+        destroy_polygon((Polygon*) obj->figure);
+        break;
+    case FIGURE_MESH:
+        destroy_mesh((Mesh*) obj->figure);
+        break;
+    case FIGURE_HEIGHTFIELD:
+        destroy_heightfield((Heightfield*) obj->figure);
+        break;
+    case FIGURE_PARTICLES:
+        destroy_particles((ParticleCloud*) obj->figure);
+        break;
+    default:
+        free(obj->figure);
+        break;
+    }
+    obj->figure = NULL;
+}
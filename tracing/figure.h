@@ -0,0 +1,14 @@
+#ifndef FIGURE_H
+#define FIGURE_H
+
+#include "vector.h"
+#include "object.h"
+#include "bounding_box.h"
+
+int get_figure_intersections(Vector eye, Vector dir_vec, Object *obj, void *inter_list);
+Vector get_figure_normal_vector(Vector posn, Object *obj, int primitive);
+int get_figure_bounds(Object *obj, BoundingBox *box);
+Color get_figure_color(Object *obj, int primitive);
+void destroy_figure(Object *obj);
+
+#endif
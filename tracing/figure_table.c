@@ -0,0 +1,337 @@
+/* figure_table.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Stores the figures of the scene by figure type, and tests a ray against
+ * several figures of the same type at once. The figures that can't be hit are
+ * discarded in a loop without branches or function calls, and only the
+ * remaining ones go through the intersection functions of their objects.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../utilities/memory_handler.h"
+#include "../figures/sphere.h"
+#include "../figures/plane.h"
+#include "../figures/cylinder.h"
+#include "../figures/cone.h"
+#include "vector.h"
+#include "object.h"
+#include "intersection.h"
+#include "figure_table.h"
+#include "figure.h"
+
+// Methods
+
+/*
+ * Builds the index of a figure table, and returns how many entries it has.
+ *
+ * index: Output parameter for the index. Its starts are allocated here.
+ * objs: List of objects of the scene.
+ * items: Positions in 'objs' of the objects that the table is built for.
+ * items_length: Number of items.
+ * type: Type of the figures held by the table.
+ * other_type: Second type, for tables of two figures. Otherwise it is 'type' again.
+ */
+int build_table_index(TableIndex *index,
+                      Object *objs,
+                      const int *items,
+                      int items_length,
+                      FigureType type,
+                      FigureType other_type)
+{
+    Object *obj;
+    int item_i;
+
+    index->starts = (int*) get_memory(sizeof(int) * (items_length + 1), NULL);
+    index->length = 0;
+    for(item_i = 0; item_i < items_length; item_i++)
+    {
+        index->starts[item_i] = index->length;
+        obj = &objs[items[item_i]];
+        if(obj->type == type || obj->type == other_type)
+            index->length++;
+    }
+    index->starts[items_length] = index->length;
+    return index->length;
+}
+
+/*
+ * Builds the figure tables of a list of objects. The tables keep the order of
+ * the items.
+ *
+ * objs: List of objects of the scene.
+ * items: Positions in 'objs' of the objects that the tables are built for.
+ * items_length: Number of items.
+ */
+FigureTables build_figure_tables(Object *objs, const int *items, int items_length)
+{
+    FigureTables tables;
+    SphereTable *spheres = &tables.spheres;
+    PlaneTable *planes = &tables.planes;
+    AxisTable *axes = &tables.axes;
+    Sphere *sphere;
+    Plane *plane;
+    Cylinder *cyl;
+    Object *obj;
+    int item_i, entry_i;
+
+    build_table_index(&spheres->index, objs, items, items_length, FIGURE_SPHERE, FIGURE_SPHERE);
+    spheres->center_x = (Real*) get_memory(sizeof(Real) * (spheres->index.length + 1), NULL);
+    spheres->center_y = (Real*) get_memory(sizeof(Real) * (spheres->index.length + 1), NULL);
+    spheres->center_z = (Real*) get_memory(sizeof(Real) * (spheres->index.length + 1), NULL);
+    spheres->radius_pow = (Real*) get_memory(sizeof(Real) * (spheres->index.length + 1), NULL);
+    build_table_index(&planes->index, objs, items, items_length, FIGURE_PLANE, FIGURE_PLANE);
+    planes->normal_x = (Real*) get_memory(sizeof(Real) * (planes->index.length + 1), NULL);
+    planes->normal_y = (Real*) get_memory(sizeof(Real) * (planes->index.length + 1), NULL);
+    planes->normal_z = (Real*) get_memory(sizeof(Real) * (planes->index.length + 1), NULL);
+    planes->offset = (Real*) get_memory(sizeof(Real) * (planes->index.length + 1), NULL);
+    build_table_index(&axes->index, objs, items, items_length, FIGURE_CYLINDER, FIGURE_CONE);
+    axes->axis_x = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->axis_y = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->axis_z = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->anchor_x = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->anchor_y = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->anchor_z = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->radius_pow = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    axes->ratio_pow = (Real*) get_memory(sizeof(Real) * (axes->index.length + 1), NULL);
+    for(item_i = 0; item_i < items_length; item_i++)
+    {
+        obj = &objs[items[item_i]];
+        if(spheres->index.starts[item_i + 1] > spheres->index.starts[item_i])
+        {
+            entry_i = spheres->index.starts[item_i];
+            sphere = (Sphere*) obj->figure;
+            spheres->center_x[entry_i] = sphere->center.x;
+            spheres->center_y[entry_i] = sphere->center.y;
+            spheres->center_z[entry_i] = sphere->center.z;
+            spheres->radius_pow[entry_i] = sphere->radius_pow;
+        }
+        else if(planes->index.starts[item_i + 1] > planes->index.starts[item_i])
+        {
+            entry_i = planes->index.starts[item_i];
+            plane = (Plane*) obj->figure;
+            planes->normal_x[entry_i] = plane->direction.x;
+            planes->normal_y[entry_i] = plane->direction.y;
+            planes->normal_z[entry_i] = plane->direction.z;
+            planes->offset[entry_i] = plane->offset;
+        }
+        else if(axes->index.starts[item_i + 1] > axes->index.starts[item_i])
+        {
+            entry_i = axes->index.starts[item_i];
+            cyl = (Cylinder*) obj->figure;
+            axes->axis_x[entry_i] = cyl->direction.x;
+            axes->axis_y[entry_i] = cyl->direction.y;
+            axes->axis_z[entry_i] = cyl->direction.z;
+            axes->anchor_x[entry_i] = cyl->anchor.x;
+            axes->anchor_y[entry_i] = cyl->anchor.y;
+            axes->anchor_z[entry_i] = cyl->anchor.z;
+            // Cones store their width::height ratio as radius
+            if(obj->type == FIGURE_CONE)
+            {
+                axes->radius_pow[entry_i] = 0.0;
+                axes->ratio_pow[entry_i] = cyl->radius_pow;
+            }
+            else
+            {
+                axes->radius_pow[entry_i] = cyl->radius_pow;
+                axes->ratio_pow[entry_i] = 0.0;
+            }
+        }
+    }
+    return tables;
+}
+
+/*
+ * Frees the memory used by the figure tables.
+ *
+ * tables: Tables that will be destroyed.
+ */
+void destroy_figure_tables(FigureTables *tables)
+{
+    free(tables->spheres.index.starts);
+    free(tables->spheres.center_x);
+    free(tables->spheres.center_y);
+    free(tables->spheres.center_z);
+    free(tables->spheres.radius_pow);
+    free(tables->planes.index.starts);
+    free(tables->planes.normal_x);
+    free(tables->planes.normal_y);
+    free(tables->planes.normal_z);
+    free(tables->planes.offset);
+    free(tables->axes.index.starts);
+    free(tables->axes.axis_x);
+    free(tables->axes.axis_y);
+    free(tables->axes.axis_z);
+    free(tables->axes.anchor_x);
+    free(tables->axes.anchor_y);
+    free(tables->axes.anchor_z);
+    free(tables->axes.radius_pow);
+    free(tables->axes.ratio_pow);
+}
+
+/*
+ * Calculates the discriminant of the cuadratic function of a ray and each
+ * sphere between 'beg' and 'end' (not included). Spheres with a negative
+ * discriminant can't be hit. They are the same terms used by
+ * 'get_sphere_intersection'.
+ *
+ * spheres: Table of the spheres.
+ * beg: First entry of the table.
+ * end: Entry after the last one.
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * discrs: Output list for the discriminants, starting with the 'beg' entry.
+ */
+void get_sphere_discriminants(const SphereTable *spheres, int beg, int end, Vector eye, Vector dir_vec, Real *discrs)
+{
+    Real diff_x, diff_y, diff_z, b, c;
+    int entry_i;
+
+    for(entry_i = beg; entry_i < end; entry_i++)
+    {
+        diff_x = eye.x - spheres->center_x[entry_i];
+        diff_y = eye.y - spheres->center_y[entry_i];
+        diff_z = eye.z - spheres->center_z[entry_i];
+        b = 2.0 * (dir_vec.x * diff_x + dir_vec.y * diff_y + dir_vec.z * diff_z);
+        c = diff_x * diff_x + diff_y * diff_y + diff_z * diff_z - spheres->radius_pow[entry_i];
+        discrs[entry_i - beg] = b * b - 4 * c;
+    }
+}
+
+/*
+ * Calculates the distance from the eye to each plane between 'beg' and 'end'
+ * (not included) following a ray. Planes whose distance isn't positive can't
+ * be hit. It is the same distance used by 'get_plane_intersection'.
+ *
+ * planes: Table of the planes.
+ * beg: First entry of the table.
+ * end: Entry after the last one.
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * distances: Output list for the distances, starting with the 'beg' entry.
+ */
+void get_plane_distances(const PlaneTable *planes, int beg, int end, Vector eye, Vector dir_vec, Real *distances)
+{
+    Real dir_factor;
+    int entry_i;
+
+    for(entry_i = beg; entry_i < end; entry_i++)
+    {
+        dir_factor = planes->normal_x[entry_i] * dir_vec.x +
+                     planes->normal_y[entry_i] * dir_vec.y +
+                     planes->normal_z[entry_i] * dir_vec.z;
+        distances[entry_i - beg] = - (planes->normal_x[entry_i] * eye.x +
+                                      planes->normal_y[entry_i] * eye.y +
+                                      planes->normal_z[entry_i] * eye.z +
+                                      planes->offset[entry_i]) / dir_factor;
+    }
+}
+
+/*
+ * Calculates the terms and the discriminant of the cuadratic function of a
+ * ray and each cylinder or cone between 'beg' and 'end' (not included).
+ * Figures with a negative discriminant can't be hit. They are the same terms
+ * used by 'get_cylinder_intersection' and 'get_cone_intersection'.
+ *
+ * axes: Table of the cylinders and cones.
+ * beg: First entry of the table.
+ * end: Entry after the last one.
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * a, b, c: Output lists for the terms, starting with the 'beg' entry.
+ * discrs: Output list for the discriminants, starting with the 'beg' entry.
+ */
+void get_axis_terms(const AxisTable *axes, int beg, int end, Vector eye, Vector dir_vec,
+                    Real *a, Real *b, Real *c, Real *discrs)
+{
+    Real term_qd, term_qe, var_d_x, var_d_y, var_d_z, var_e_x, var_e_y, var_e_z;
+    int entry_i, term_i;
+
+    for(entry_i = beg; entry_i < end; entry_i++)
+    {
+        term_i = entry_i - beg;
+        term_qd = axes->axis_x[entry_i] * dir_vec.x +
+                  axes->axis_y[entry_i] * dir_vec.y +
+                  axes->axis_z[entry_i] * dir_vec.z;
+        term_qe = axes->axis_x[entry_i] * (eye.x - axes->anchor_x[entry_i]) +
+                  axes->axis_y[entry_i] * (eye.y - axes->anchor_y[entry_i]) +
+                  axes->axis_z[entry_i] * (eye.z - axes->anchor_z[entry_i]);
+        var_d_x = axes->axis_x[entry_i] * term_qd - dir_vec.x;
+        var_d_y = axes->axis_y[entry_i] * term_qd - dir_vec.y;
+        var_d_z = axes->axis_z[entry_i] * term_qd - dir_vec.z;
+        var_e_x = axes->anchor_x[entry_i] + (axes->axis_x[entry_i] * term_qe - eye.x);
+        var_e_y = axes->anchor_y[entry_i] + (axes->axis_y[entry_i] * term_qe - eye.y);
+        var_e_z = axes->anchor_z[entry_i] + (axes->axis_z[entry_i] * term_qe - eye.z);
+        a[term_i] = var_d_x * var_d_x + var_d_y * var_d_y + var_d_z * var_d_z -
+                    axes->ratio_pow[entry_i] * (term_qd * term_qd);
+        b[term_i] = 2 * (var_e_x * var_d_x + var_e_y * var_d_y + var_e_z * var_d_z -
+                         axes->ratio_pow[entry_i] * term_qd * term_qe);
+        c[term_i] = var_e_x * var_e_x + var_e_y * var_e_y + var_e_z * var_e_z -
+                    (axes->radius_pow[entry_i] + axes->ratio_pow[entry_i] * (term_qe * term_qe));
+        discrs[term_i] = b[term_i] * b[term_i] - 4 * a[term_i] * c[term_i];
+    }
+}
+
+/*
+ * Finds the intersections of a ray with the items between 'beg' and 'end'
+ * (not included), and returns how many were found. The figures of each type
+ * are tested together first, and only the ones that may be hit are
+ * intersected. The intersections are written in the order of the items, and
+ * the ones cut by a cutting plane are marked as invalid. Items whose cutting
+ * planes cut the whole ray are skipped.
+ *
+ * tables: Figure tables built for the list of items.
+ * objs: List of objects of the scene.
+ * items: Positions in 'objs' of the objects of the list.
+ * beg: First item that is tested.
+ * end: Item after the last one. At most FIGURE_BATCH_SIZE items are tested.
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction towards which the ray is thrown. Must be normalized.
+ * max_distance: Distance beyond which the hits of the ray are discarded.
+ * inter_list: Output list (of Intersection structs) with space for
+ *             MAX_FIGURE_INTERSECTIONS intersections per item.
+ */
+int get_table_intersections(const FigureTables *tables, Object *objs, const int *items, int beg, int end,
+                            Vector eye, Vector dir_vec, Real max_distance, void *inter_list)
+{
+    Intersection *inter_found = (Intersection*) inter_list;
+    Real sphere_discrs[FIGURE_BATCH_SIZE], plane_distances[FIGURE_BATCH_SIZE];
+    Real axis_a[FIGURE_BATCH_SIZE], axis_b[FIGURE_BATCH_SIZE], axis_c[FIGURE_BATCH_SIZE], axis_discrs[FIGURE_BATCH_SIZE];
+    const int *sphere_starts = tables->spheres.index.starts;
+    const int *plane_starts = tables->planes.index.starts;
+    const int *axis_starts = tables->axes.index.starts;
+    Object *obj;
+    int item_i, term_i, length, inter_amount;
+
+    get_sphere_discriminants(&tables->spheres, sphere_starts[beg], sphere_starts[end], eye, dir_vec, sphere_discrs);
+    get_plane_distances(&tables->planes, plane_starts[beg], plane_starts[end], eye, dir_vec, plane_distances);
+    get_axis_terms(&tables->axes, axis_starts[beg], axis_starts[end], eye, dir_vec, axis_a, axis_b, axis_c, axis_discrs);
+    length = 0;
+    for(item_i = beg; item_i < end; item_i++)
+    {
+        obj = &objs[items[item_i]];
+        if(obj->cutting_planes_length && is_ray_cut(obj, eye, dir_vec, max_distance)) continue;
+        if(sphere_starts[item_i + 1] > sphere_starts[item_i])
+        {
+            if(sphere_discrs[sphere_starts[item_i] - sphere_starts[beg]] < 0) continue;
+            inter_amount = get_sphere_intersection(eye, dir_vec, obj, &inter_found[length]);
+        }
+        else if(plane_starts[item_i + 1] > plane_starts[item_i])
+        {
+            if(!(plane_distances[plane_starts[item_i] - plane_starts[beg]] > 0)) continue;
+            inter_amount = get_plane_intersection(eye, dir_vec, obj, &inter_found[length]);
+        }
+        else if(axis_starts[item_i + 1] > axis_starts[item_i])
+        {
+            term_i = axis_starts[item_i] - axis_starts[beg];
+            if(axis_discrs[term_i] < 0) continue;
+            inter_amount = get_cyl_cone_intersection(axis_a[term_i], axis_b[term_i], axis_c[term_i],
+                                                     eye, dir_vec, obj, &inter_found[length]);
+        }
+        else inter_amount = get_figure_intersections(eye, dir_vec, obj, &inter_found[length]);
+        length += cut_object_intersections(obj, &inter_found[length], inter_amount);
+    }
+    return length;
+}
@@ -0,0 +1,104 @@
+#ifndef FIGURE_TABLE_H
+#define FIGURE_TABLE_H
+
+#include "vector.h"
+#include "object.h"
+
+// Maximum number of items that are tested at once against a ray
+#define FIGURE_BATCH_SIZE 8
+
+/*
+ * Tells which items of a list of objects have an entry on a figure table.
+ * Entries are stored in the same order as the items, so the items of a
+ * hierarchy leaf have their entries together.
+ *
+ * starts: Position of the first entry of each item. The item 'i' has an entry
+ *         only if 'starts[i + 1]' is greater than 'starts[i]'. It has one more
+ *         position than the list of items.
+ * length: Number of entries on the table.
+ */
+typedef struct
+{
+    int *starts;
+    int length;
+} TableIndex;
+
+/*
+ * Holds the spheres of a list of objects, one array per attribute.
+ *
+ * index: Items that have an entry on the table.
+ * center_x, center_y, center_z: Centers of the spheres.
+ * radius_pow: Squared radius of the spheres.
+ */
+typedef struct
+{
+    TableIndex index;
+    Real *center_x;
+    Real *center_y;
+    Real *center_z;
+    Real *radius_pow;
+} SphereTable;
+
+/*
+ * Holds the planes of a list of objects, one array per attribute.
+ *
+ * index: Items that have an entry on the table.
+ * normal_x, normal_y, normal_z: Directions at which the planes are looking.
+ * offset: Offsets of the planes.
+ */
+typedef struct
+{
+    TableIndex index;
+    Real *normal_x;
+    Real *normal_y;
+    Real *normal_z;
+    Real *offset;
+} PlaneTable;
+
+/*
+ * Holds the cylinders and cones of a list of objects, one array per attribute.
+ * Both figures share the same cuadratic function, a cylinder is a cone whose
+ * ratio is 0 and a cone is a cylinder whose radius is 0.
+ *
+ * index: Items that have an entry on the table.
+ * axis_x, axis_y, axis_z: Directions of the axes.
+ * anchor_x, anchor_y, anchor_z: Anchors of the axes.
+ * radius_pow: Squared radius of the cylinders. It is 0 for cones.
+ * ratio_pow: Squared width::height ratio of the cones. It is 0 for cylinders.
+ */
+typedef struct
+{
+    TableIndex index;
+    Real *axis_x;
+    Real *axis_y;
+    Real *axis_z;
+    Real *anchor_x;
+    Real *anchor_y;
+    Real *anchor_z;
+    Real *radius_pow;
+    Real *ratio_pow;
+} AxisTable;
+
+/*
+ * Holds the figures of a list of objects by figure type, so a ray can be tested
+ * against several figures of the same type at once. The objects keep their
+ * figures and materials, the tables are only used to find intersections.
+ * Figures of other types are tested through their object.
+ *
+ * spheres: Spheres of the list.
+ * planes: Planes of the list.
+ * axes: Cylinders and cones of the list.
+ */
+typedef struct
+{
+    SphereTable spheres;
+    PlaneTable planes;
+    AxisTable axes;
+} FigureTables;
+
+FigureTables build_figure_tables(Object *objs, const int *items, int items_length);
+void destroy_figure_tables(FigureTables *tables);
+int get_table_intersections(const FigureTables *tables, Object *objs, const int *items, int beg, int end,
+                            Vector eye, Vector dir_vec, Real max_distance, void *inter_list);
+
+#endif
@@ -13,128 +13,376 @@
 #include "vector.h"
 #include "intersection.h"
 #include "object.h"
-
-// Constants
-#define INTER_EPSILON 0.001
+#include "bounding_box.h"
+#include "bvh.h"
+#include "figure_table.h"
+#include "figure.h"
 
 // Methods
 
 /*
- * Swaps the values of intersection pointers.
+ * Marks as invalid the intersections of 'obj' that are cut by its cutting
+ * planes, and returns how many intersections there are.
+ *
+ * obj: Object to which the intersections belong.
+ * inter_list: List of intersections with the object.
+ * inter_amount: Number of intersections on the list.
  */
-void swap_intersections(Intersection* inter1, Intersection* inter2)
+int cut_object_intersections(Object *obj, Intersection *inter_list, int inter_amount)
 {
-	Intersection temp = *inter1;
-	*inter1 = *inter2;
-	*inter2 = temp;
+    Intersection inter;
+    int cut_plane_i, inter_i;
+    // Check each cutting plane
+    for(cut_plane_i = 0; cut_plane_i < obj->cutting_planes_length; cut_plane_i++)
+    {
+        Plane cutting_plane = obj->cutting_planes[cut_plane_i];
+        for(inter_i = 0; inter_i < inter_amount; inter_i++)
+        {   // Check each intersection with the object
+            inter = inter_list[inter_i];
+            if(inter.is_valid && is_up_the_plane(inter.posn, cutting_plane))
+            {   // Intersecion is cut
+                inter_list[inter_i].is_valid = 0;
+            }
+        }
+    }
+	return inter_amount;
 }
 
 /*
- * Orders an intersection array (using Quicksort) according to the distance
- * that each intersection has from the eye. The intersections with the shortest
- * distance from the eye go first.
+ * Returns true if every position of a ray nearer than 'max_distance' is cut by
+ * one of the cutting planes of 'obj', so the object can't be hit by the ray.
+ * A small margin keeps the test from discarding hits that
+ * 'cut_object_intersections' would keep.
+ *
+ * obj: Object whose cutting planes are checked.
+ * eye: Position from which the ray is thrown.
+ * dir_vec: Direction to which the ray travels. Must be normalized.
+ * max_distance: Distance beyond which the hits of the ray are discarded.
  */
-void sort_intersections(Intersection arr[], int beg, int end)
+int is_ray_cut(Object *obj, Vector eye, Vector dir_vec, Real max_distance)
 {
-	if (end > beg + 1)
-	{
-		int piv = arr[beg].distance, l = beg + 1, r = end;
-		while (l < r)
-		{
-			if (arr[l].distance <= piv)
-				l++;
-			else
-				swap_intersections(&arr[l], &arr[--r]);
-		}
-		swap_intersections(&arr[--l], &arr[beg]);
-		sort_intersections(arr, beg, l);
-		sort_intersections(arr, r, end);
-  	}
+    Real eye_side, dir_side;
+    int cut_plane_i;
+    for(cut_plane_i = 0; cut_plane_i < obj->cutting_planes_length; cut_plane_i++)
+    {
+        eye_side = do_dot_product(obj->cutting_planes[cut_plane_i].direction, eye) + obj->cutting_planes[cut_plane_i].offset;
+        dir_side = do_dot_product(obj->cutting_planes[cut_plane_i].direction, dir_vec);
+        // The ray is farthest below the plane at one of its ends
+        if(dir_side < 0) eye_side += dir_side * max_distance;
+        if(eye_side >= REAL_TOLERANCE) return 1;
+    }
+    return 0;
 }
 
 /*
- * Returns the intersection with 'object' and a ray thrown from 'eye' position
- * towards 'dir_vec' direction. If there is not any intersection, it returns
- * NULL.
+ * Finds the intersections of 'object' and a ray thrown from 'eye' position
+ * towards 'dir_vec' direction, and returns how many were found. Rays that are
+ * cut before reaching the object are not tested against its figure.
  *
  * eye: Position from which the intersection ray is thrown.
  * dir_vec: Direction to which the ray travels. Must be normalized.
  * obj: Object with which the intersection with the ray is calculated.
- * inter_amount: Output parameter to indicate how many intersections were returned.
+ * max_distance: Distance beyond which the hits of the ray are discarded.
+ * inter_list: Output list with space for MAX_FIGURE_INTERSECTIONS intersections.
  */
-Intersection* get_object_intersection(Vector eye, Vector dir_vec, Object obj, int *inter_amount)
+int get_object_intersection(Vector eye, Vector dir_vec, Object *obj, Real max_distance, Intersection *inter_list)
 {
-    Intersection* inter_list;
-    Intersection inter;
-    int cut_plane_i, inter_i;
-	inter_list = (Intersection*) obj.get_intersections(eye, dir_vec, &obj, inter_amount);
-	if(inter_list)
-    {   // Check each cutting plane
-        for(cut_plane_i = 0; cut_plane_i < obj.cutting_planes_length; cut_plane_i++)
+    int inter_amount;
+    if(obj->cutting_planes_length && is_ray_cut(obj, eye, dir_vec, max_distance)) return 0;
+	inter_amount = get_figure_intersections(eye, dir_vec, obj, inter_list);
+	return cut_object_intersections(obj, inter_list, inter_amount);
+}
+
+/*
+ * Inserts an intersection on a list that keeps, ordered by distance, only the
+ * 'max_length' nearest intersections found so far. When the list is full, the
+ * farthest intersection is dropped.
+ *
+ * inter: Intersection that is inserted.
+ * inter_list: List of the nearest intersections, ordered by distance.
+ * length: Input/Output parameter for the length of the list.
+ * max_length: Maximum number of intersections that the list keeps.
+ */
+void insert_nearest_intersection(Intersection inter, Intersection *inter_list, int *length, int max_length)
+{
+    int inter_i;
+    if(*length == max_length)
+    {
+        if(inter.distance >= inter_list[max_length - 1].distance) return;
+        inter_i = max_length - 1;
+    }
+    else inter_i = (*length)++;
+    // Move the farther intersections one position back
+    for(; inter_i > 0 && inter_list[inter_i - 1].distance > inter.distance; inter_i--)
+        inter_list[inter_i] = inter_list[inter_i - 1];
+    inter_list[inter_i] = inter;
+}
+
+/*
+ * Adds the valid intersections found by a ray to a list of the nearest
+ * intersections, and shrinks the search distance once the list is full.
+ *
+ * found_list: Intersections found by the ray.
+ * found_amount: Number of intersections found.
+ * inter_list: List of the nearest intersections, ordered by distance.
+ * length: Input/Output parameter for the length of the list.
+ * max_length: Maximum number of intersections that the list keeps.
+ * max_distance: Input/Output parameter for the distance beyond which
+ *               intersections can be discarded.
+ */
+void add_nearest_found_intersections(Intersection *found_list,
+                                     int found_amount,
+                                     Intersection *inter_list,
+                                     int *length,
+                                     int max_length,
+                                     Real *max_distance)
+{
+    int found_i;
+    for(found_i = 0; found_i < found_amount; found_i++)
+    {
+        if(found_list[found_i].is_valid && found_list[found_i].distance > INTER_EPSILON)
         {
-            Plane cutting_plane = obj.cutting_planes[cut_plane_i];
-            for(inter_i = 0; inter_i < *inter_amount; inter_i++)
-            {   // Check each intersection with the object
-                inter = inter_list[inter_i];
-                if(inter.is_valid && is_up_the_plane(inter.posn, cutting_plane))
-                {   // Intersecion is cut
-                    inter_list[inter_i].is_valid = 0;
-                }
-            }
+            insert_nearest_intersection(found_list[found_i], inter_list, length, max_length);
         }
     }
-	return inter_list;
+    if(*length == max_length) *max_distance = inter_list[max_length - 1].distance;
+}
+
+/*
+ * Adds the valid intersections of a ray with 'obj' to a list of the nearest
+ * intersections, and shrinks the search distance once the list is full.
+ *
+ * eye: Anchor of the ray that is used to find intersections
+ * dir_vec: Direction of the ray. This vector must be normalized.
+ * obj: Object with which the intersections are calculated.
+ * inter_list: List of the nearest intersections, ordered by distance.
+ * length: Input/Output parameter for the length of the list.
+ * max_length: Maximum number of intersections that the list keeps.
+ * max_distance: Input/Output parameter for the distance beyond which
+ *               intersections can be discarded.
+ */
+void add_nearest_object_intersections(Vector eye,
+                                      Vector dir_vec,
+                                      Object *obj,
+                                      Intersection *inter_list,
+                                      int *length,
+                                      int max_length,
+                                      Real *max_distance)
+{
+    Intersection obj_inter_list[MAX_FIGURE_INTERSECTIONS];
+    int obj_inter_amount;
+    obj_inter_amount = get_object_intersection(eye, dir_vec, obj, *max_distance, obj_inter_list);
+    add_nearest_found_intersections(obj_inter_list, obj_inter_amount, inter_list, length, max_length, max_distance);
+}
+
+/*
+ * Adds the valid intersections of a ray with the items between 'beg' and 'end'
+ * (not included) of an object list to a list of the nearest intersections.
+ * The items are tested in batches through the figure tables of the list.
+ *
+ * eye: Anchor of the ray that is used to find intersections
+ * dir_vec: Direction of the ray. This vector must be normalized.
+ * tables: Figure tables built for the list of items.
+ * items: Positions in 'conf->objs' of the objects of the list.
+ * beg: First item that is tested.
+ * end: Item after the last one.
+ * inter_list: List of the nearest intersections, ordered by distance.
+ * length: Input/Output parameter for the length of the list.
+ * max_length: Maximum number of intersections that the list keeps.
+ * max_distance: Input/Output parameter for the distance beyond which
+ *               intersections can be discarded.
+ * conf: Configuration of the scene.
+ */
+void add_nearest_item_intersections(Vector eye,
+                                    Vector dir_vec,
+                                    const FigureTables *tables,
+                                    const int *items,
+                                    int beg,
+                                    int end,
+                                    Intersection *inter_list,
+                                    int *length,
+                                    int max_length,
+                                    Real *max_distance,
+                                    const SceneConfig *conf)
+{
+    Intersection batch_inter_list[MAX_FIGURE_INTERSECTIONS * FIGURE_BATCH_SIZE];
+    int batch_inter_amount, batch_end;
+    for(; beg < end; beg = batch_end)
+    {
+        batch_end = beg + FIGURE_BATCH_SIZE < end ? beg + FIGURE_BATCH_SIZE : end;
+        batch_inter_amount = get_table_intersections(tables, conf->objs, items, beg, batch_end, eye, dir_vec, *max_distance,
+                                                     batch_inter_list);
+        add_nearest_found_intersections(batch_inter_list, batch_inter_amount, inter_list, length, max_length, max_distance);
+    }
 }
 
 /*
- * Obtains the intersections found from the 'eye' position towards the
- * 'dir_vec' direction. The intersection list is ordered from the nearest
- * intersection to the farthest one. It also receives a 'length' output
- * parameter to indicate the intersection list length. If there are not any
- * intersections, NULL is returned.
+ * Obtains the 'max_length' nearest intersections found from the 'eye' position
+ * towards the 'dir_vec' direction, ordered from the nearest to the farthest,
+ * and returns how many of them were found. Only the intersections that are
+ * needed are kept, so the search distance shrinks as intersections are found
+ * and the hierarchy nodes beyond it are skipped. The children of each node are
+ * visited from the nearest to the farthest to shrink it as soon as possible.
  *
  * eye: Anchor of the ray that is used to find intersections
  * dir_vec: Direction of the ray. This vector must be normalized.
- * length: Output parameter to indicate how many intersections were returned.
+ * max_length: Number of intersections that are needed. For opaque scenes it is
+ *             1, so only the closest intersection is searched.
+ * inter_list: Output list with space for 'max_length' intersections.
  * conf: Configuration of the scene.
  */
-Intersection* get_intersections(Vector eye, Vector dir_vec, int* length, SceneConfig conf)
+int get_nearest_intersections(Vector eye, Vector dir_vec, int max_length, Intersection *inter_list, const SceneConfig *conf)
 {
-    Intersection *inter_list, *obj_inter_list;
-    Intersection obj_inter;
-    int obj_index, inter_index, obj_inter_amount, obj_inter_i;
-	// Create an intersection list with the maximum of intersections that can be found.
-	inter_list = get_memory(sizeof(Intersection) * conf.objs_length * 2, NULL);
-	inter_index = 0;
-	for(obj_index = 0; obj_index < conf.objs_length; obj_index++)
+    BvhNode *node;
+    Vector inv_dir_vec;
+    Real max_distance, near_distance, left_distance, right_distance;
+    int length, node_i, stack_length, left_hit, right_hit;
+    int node_stack[BVH_MAX_DEPTH + 1];
+    Real distance_stack[BVH_MAX_DEPTH + 1];
+
+    length = 0;
+    max_distance = INFINITY;
+	add_nearest_item_intersections(eye, dir_vec, &conf->unbounded_tables, conf->unbounded_objs, 0, conf->unbounded_objs_length,
+                                   inter_list, &length, max_length, &max_distance, conf);
+	inv_dir_vec = get_inverse_direction(dir_vec);
+	stack_length = 0;
+	if(conf->objs_bvh.nodes_length && is_box_hit(conf->objs_bvh.nodes[0].box, eye, inv_dir_vec, max_distance, &near_distance))
+    {
+        node_stack[stack_length] = 0;
+        distance_stack[stack_length++] = near_distance;
+    }
+	while(stack_length > 0)
 	{
-		// For each object in the scene we look for an intersection
-		obj_inter_list = get_object_intersection(eye, dir_vec, conf.objs[obj_index], &obj_inter_amount);
-		if(obj_inter_list)
-		{
-			for(obj_inter_i = 0; obj_inter_i < obj_inter_amount; obj_inter_i++)
+	    node_i = node_stack[--stack_length];
+	    // The search distance may have shrunk since the node was pushed
+	    if(distance_stack[stack_length] > max_distance) continue;
+	    node = &conf->objs_bvh.nodes[node_i];
+	    if(node->length)
+	    {
+	        add_nearest_item_intersections(eye, dir_vec, &conf->objs_tables, conf->objs_bvh.indexes, node->first,
+                                           node->first + node->length, inter_list, &length, max_length, &max_distance, conf);
+            continue;
+	    }
+        left_hit = is_box_hit(conf->objs_bvh.nodes[node_i + 1].box, eye, inv_dir_vec, max_distance, &left_distance);
+        right_hit = is_box_hit(conf->objs_bvh.nodes[node->right_child].box, eye, inv_dir_vec, max_distance, &right_distance);
+        // The nearest child is pushed last, so it is visited first
+        if(left_hit && right_hit && left_distance <= right_distance)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+            right_hit = 0;
+        }
+        if(left_hit)
+        {
+            node_stack[stack_length] = node_i + 1;
+            distance_stack[stack_length++] = left_distance;
+        }
+        if(right_hit)
+        {
+            node_stack[stack_length] = node->right_child;
+            distance_stack[stack_length++] = right_distance;
+        }
+	}
+	return length;
+}
+
+/*
+ * Filters the light that goes through the valid intersections of a shadow ray
+ * with the items between 'beg' and 'end' (not included) of an object list
+ * that are nearer than 'max_distance'. Returns false if the light was
+ * completely blocked. The items are tested in batches through the figure
+ * tables of the list.
+ *
+ * eye: Position from which the shadow ray is thrown.
+ * dir_vec: Direction towards the light. This vector must be normalized.
+ * tables: Figure tables built for the list of items.
+ * items: Positions in 'conf->objs' of the objects of the list.
+ * beg: First item that is tested.
+ * end: Item after the last one.
+ * max_distance: Distance to the light.
+ * light_filter: Input/Output parameter for the light that gets through.
+ * conf: Configuration of the scene.
+ */
+int filter_items_light(Vector eye,
+                       Vector dir_vec,
+                       const FigureTables *tables,
+                       const int *items,
+                       int beg,
+                       int end,
+                       Real max_distance,
+                       Color *light_filter,
+                       const SceneConfig *conf)
+{
+    Intersection batch_inter_list[MAX_FIGURE_INTERSECTIONS * FIGURE_BATCH_SIZE];
+    Intersection inter;
+    Color inter_color;
+    int batch_inter_amount, batch_inter_i, batch_end;
+    for(; beg < end; beg = batch_end)
+    {
+        batch_end = beg + FIGURE_BATCH_SIZE < end ? beg + FIGURE_BATCH_SIZE : end;
+        batch_inter_amount = get_table_intersections(tables, conf->objs, items, beg, batch_end, eye, dir_vec, max_distance,
+                                                     batch_inter_list);
+        for(batch_inter_i = 0; batch_inter_i < batch_inter_amount; batch_inter_i++)
+        {
+            inter = batch_inter_list[batch_inter_i];
+            if(inter.is_valid && inter.distance > INTER_EPSILON && inter.distance < max_distance)
             {
-                obj_inter = obj_inter_list[obj_inter_i];
-                // Special condition for shadows, to check for a distance larger than 0 (INTER_EPSILON)
-                if(obj_inter.is_valid && obj_inter.distance > INTER_EPSILON)
-                {
-                    inter_list[inter_index++] = obj_inter;
-                }
+                inter_color = get_figure_color(inter.obj, inter.primitive);
+                light_filter->red = inter.obj->translucency_material * (light_filter->red * inter_color.red);
+                light_filter->green = inter.obj->translucency_material * (light_filter->green * inter_color.green);
+                light_filter->blue = inter.obj->translucency_material * (light_filter->blue * inter_color.blue);
+                if(light_filter->red == 0.0 && light_filter->green == 0.0 && light_filter->blue == 0.0) return 0;
             }
-			free(obj_inter_list);
-		}
-	}
-	// We return the list only if we found at least one intersection, otherwise we return NULL
-	if (inter_index > 0)
-	{
-		sort_intersections(inter_list, 0, inter_index);
-		if(length) *length = inter_index;
-		return inter_list;
-	}
-	else
+        }
+    }
+    return light_filter->red != 0.0 || light_filter->green != 0.0 || light_filter->blue != 0.0;
+}
+
+/*
+ * Returns the light filter of a shadow ray thrown from 'eye' towards a light
+ * that is 'light_distance' away. Only the objects between the eye and the
+ * light are searched, and the search stops as soon as the light is completely
+ * blocked (for example by an opaque object), returning an empty filter.
+ * Translucent objects multiply the filter by their color and translucency.
+ * Since the filters are multiplied, they don't need to be sorted.
+ *
+ * eye: Position from which the shadow ray is thrown.
+ * dir_vec: Direction towards the light. This vector must be normalized.
+ * light_distance: Distance to the light.
+ * conf: Configuration of the scene.
+ */
+Color get_light_filter(Vector eye, Vector dir_vec, Real light_distance, const SceneConfig *conf)
+{
+    Color light_filter, shadow_color;
+    BvhNode *node;
+    Vector inv_dir_vec;
+    int node_i, stack_length;
+    int node_stack[BVH_MAX_DEPTH];
+
+    light_filter = (Color){ .red = 1.0, .green = 1.0, .blue = 1.0 };
+    shadow_color = (Color){ .red = 0.0, .green = 0.0, .blue = 0.0 };
+	if(!filter_items_light(eye, dir_vec, &conf->unbounded_tables, conf->unbounded_objs, 0, conf->unbounded_objs_length,
+                           light_distance, &light_filter, conf))
+        return shadow_color;
+	inv_dir_vec = get_inverse_direction(dir_vec);
+	stack_length = 0;
+	if(conf->objs_bvh.nodes_length) node_stack[stack_length++] = 0;
+	while(stack_length > 0)
 	{
-		if(length) *length = 0;
-		free(inter_list);
-		return NULL;
+	    node_i = node_stack[--stack_length];
+	    node = &conf->objs_bvh.nodes[node_i];
+	    if(!is_box_hit(node->box, eye, inv_dir_vec, light_distance, NULL)) continue;
+	    if(node->length)
+	    {
+	        if(!filter_items_light(eye, dir_vec, &conf->objs_tables, conf->objs_bvh.indexes, node->first,
+                                   node->first + node->length, light_distance, &light_filter, conf))
+                return shadow_color;
+	    }
+	    else
+	    {
+	        node_stack[stack_length++] = node->right_child;
+	        node_stack[stack_length++] = node_i + 1;
+	    }
 	}
+	return light_filter;
 }
@@ -5,23 +5,39 @@
 #include "object.h"
 #include "../scene_config.h"
 
+// Maximum number of nearest intersections that can be searched for a ray
+#define MAX_NEAREST_INTERSECTIONS 16
+// Intersections nearer than this to the eye are discarded (they are the
+// surface from which the ray was thrown)
+#define INTER_EPSILON REAL_TOLERANCE
+
 /*
  * Represents an intersection with a scene object.
  *
  * distance: Distance at which the intersection is from the eye.
  * posn: Position at which the intersection was made.
- * obj: Object with which the intersection was made.
+ * obj: Object (of the scene object list) with which the intersection was made.
+ *      Only a pointer is kept, so intersections are cheap to copy.
  * is_valid: True if the intersection can be used. Some intersections are
  *           rendered invalid because they are cut by a cutting plane.
+ * primitive: Part of the figure that was hit, like the triangle of a mesh.
+ *            It is 0 for figures made of a single part.
  */
 typedef struct
 {
-	long double distance;
+	Real distance;
 	Vector posn;
-	Object obj;
+	Object *obj;
 	int is_valid;
+	int primitive;
 } Intersection;
 
-Intersection* get_intersections(Vector eye, Vector dir_vec, int* length, SceneConfig conf);
+int cut_object_intersections(Object *obj, Intersection *inter_list, int inter_amount);
+int is_ray_cut(Object *obj, Vector eye, Vector dir_vec, Real max_distance);
+void insert_nearest_intersection(Intersection inter, Intersection *inter_list, int *length, int max_length);
+void add_nearest_object_intersections(Vector eye, Vector dir_vec, Object *obj, Intersection *inter_list,
+                                      int *length, int max_length, Real *max_distance);
+int get_nearest_intersections(Vector eye, Vector dir_vec, int max_length, Intersection *inter_list, const SceneConfig *conf);
+Color get_light_filter(Vector eye, Vector dir_vec, Real light_distance, const SceneConfig *conf);
 
 #endif
@@ -15,6 +15,7 @@
 #include "vector.h"
 #include "intersection.h"
 #include "object.h"
+#include "figure.h"
 
 // Methods
 
@@ -87,7 +88,7 @@ Color multiply_colors(Color color1, Color color2)
  * value: Scalar value by which the color is being multiplied
  * color: Color being multiplied.
  */
-Color multiply_color(long double value, Color color)
+Color multiply_color(Real value, Color color)
 {
     color.red *= value;
     color.green *= value;
@@ -104,8 +105,7 @@ Color multiply_color(long double value, Color color)
  */
 Vector get_normal_vector(Intersection* inter)
 {
-	Object obj = inter->obj;
-	return inter->obj.get_normal_vector(inter->posn, obj.figure);
+	return get_figure_normal_vector(inter->posn, inter->obj, inter->primitive);
 }
 
 /*
@@ -115,11 +115,11 @@ Vector get_normal_vector(Intersection* inter)
  * light: Light for which the attenuation factor is calculated.
  * distance: Distance between the light and an illuminated spot.
  */
-long double get_attenuation_factor(Light light, long double distance)
+Real get_attenuation_factor(Light light, Real distance)
 {
-	long double att_factor =    1 /(light.const_att_factor +
+	Real att_factor =    1 /(light.const_att_factor +
                                 light.lin_att_factor * distance +
-                                pow(light.expo_att_factor * distance, 2.0));
+                                real_pow(light.expo_att_factor * distance, 2.0));
 	if(att_factor > 1.0) return 1.0;
 	else return att_factor;
 }
@@ -145,50 +145,21 @@ void apply_light_source(Light light,
                         Vector normal_vec,
                         Vector rev_dir_vec,
                         Color *all_lights_color,
-                        long double *all_spec_light,
-                        SceneConfig conf)
+                        Real *all_spec_light,
+                        const SceneConfig *conf)
 {
     Vector light_vec;
-    long double light_distance, illum_cos, att_factor, spec_cos;
+    Real light_distance, illum_cos, att_factor, spec_cos;
     Color light_filter;
-    Intersection* shadow_inter;
-    int shadow_i, shadow_inter_length;
-    Object shadow_obj;
 
     // Find the vector that points from the intersection point to the light
     // source, and normalize it
     light_vec = subtract_vectors(light.anchor, inter.posn);
     light_distance = normalize_vector(&light_vec);
-    // We check for any object making a shadow from that light
-    light_filter = (Color){ .red = 1.0, .green = 1.0, .blue = 1.0 };;
-    shadow_inter = get_intersections(inter.posn, light_vec, &shadow_inter_length, conf);
-    // If the intersection is beyond the light source, we ignore it
-    if(shadow_inter)
-    {   // Object(s) is/are actually behind the light
-        for(shadow_i = 0; shadow_i < shadow_inter_length && !is_color_empty(light_filter); shadow_i++)
-        {
-            if(shadow_inter[shadow_i].distance < light_distance)
-            {
-                shadow_obj = shadow_inter[shadow_i].obj;
-                if(shadow_obj.translucency_material)
-                {
-                    light_filter = multiply_color(shadow_obj.translucency_material, multiply_colors(light_filter, shadow_obj.color));
-                }
-                else
-                {
-                    light_filter = get_empty_color();
-                }
-            }
-
-        }
-        if(!is_color_empty(light_filter))
-        {
-            free(shadow_inter);
-            shadow_inter = NULL;
-        }
-    }
+    // We check for any object between the intersection and the light making a shadow
+    light_filter = get_light_filter(inter.posn, light_vec, light_distance, conf);
     // If there aren't any shadows
-    if(!shadow_inter)
+    if(!is_color_empty(light_filter))
     {
         illum_cos = do_dot_product(normal_vec, light_vec);
         // We only take it into account if the angle is lower than 90 degrees
@@ -199,16 +170,15 @@ void apply_light_source(Light light,
             att_factor = get_attenuation_factor(light, light_distance);
             spec_cos = do_dot_product(rev_dir_vec, light_mirror_vec);
             // We add the light source effect
-            light_filter = multiply_color(illum_cos * inter.obj.light_material * att_factor, light_filter);
+            light_filter = multiply_color(illum_cos * inter.obj->light_material * att_factor, light_filter);
             *all_lights_color = add_colors(*all_lights_color, multiply_colors(light_filter, light.color));
             // The specular light, is the white stain on the objects
             if(spec_cos > 0)
             {
-                *all_spec_light += pow(spec_cos * inter.obj.specular_material * att_factor, inter.obj.specular_pow);
+                *all_spec_light += real_pow(spec_cos * inter.obj->specular_material * att_factor, inter.obj->specular_pow);
             }
         }
     }
-    else free(shadow_inter);
 }
 
 /*
@@ -226,11 +196,11 @@ Color get_intersection_color(Vector eye,
                              int inter_length,
                              int mirror_level,
                              int transparency_level,
-                             SceneConfig conf)
+                             const SceneConfig *conf)
 {
     Intersection inter;
     int light_index;
-    long double spec_light_factor, mirror_factor, transparency_factor;
+    Real spec_light_factor, mirror_factor, transparency_factor;
     Vector normal_vec, rev_dir_vec, reflection_vec;
     Light light;
     Color all_lights_color, color_found, reflection_color,
@@ -247,23 +217,23 @@ Color get_intersection_color(Vector eye,
         normal_vec = multiply_vector(-1, normal_vec);
     // Initialize reverse direction vector for mirrors and specular light
     rev_dir_vec = multiply_vector(-1, dir_vec);
-    for(light_index = 0; light_index < conf.lights_length; light_index++)
+    for(light_index = 0; light_index < conf->lights_length && !inter.obj->ignores_lights; light_index++)
     {
-        light = conf.lights[light_index];
+        light = conf->lights[light_index];
         apply_light_source(light, inter, normal_vec, rev_dir_vec, &all_lights_color, &spec_light_factor, conf);
     }
     // We add the environmental light of the scene
-    all_lights_color = add_colors(all_lights_color, multiply_color(inter.obj.light_ambiental, conf.environment_light));
+    all_lights_color = add_colors(all_lights_color, multiply_color(inter.obj->light_ambiental, conf->environment_light));
     if(spec_light_factor > 1.0)
         spec_light_factor = 1.0;
-    color_found = multiply_colors(all_lights_color, inter.obj.color);
+    color_found = multiply_colors(all_lights_color, get_figure_color(inter.obj, inter.primitive));
     // Specular light gives a color between enlightened color and the light color.
     color_found.red += (1 - color_found.red) * spec_light_factor;
     color_found.green += (1 - color_found.green) * spec_light_factor;
     color_found.blue += (1 - color_found.blue) * spec_light_factor;
     // Get transparency color
-    transparency_factor = inter.obj.transparency_material;
-    if (transparency_level < conf.max_transparency_level &&
+    transparency_factor = inter.obj->transparency_material;
+    if (transparency_level < conf->max_transparency_level &&
         transparency_factor > 0.0)
     {
         if(transparency_level + 1 < inter_length)
@@ -272,7 +242,7 @@ Color get_intersection_color(Vector eye,
         }
         else
         {
-            transparency_color = conf.background;
+            transparency_color = conf->background;
         }
     }
     else
@@ -281,11 +251,13 @@ Color get_intersection_color(Vector eye,
         transparency_color = get_empty_color();
     }
     // Get reflection color
-    mirror_factor = inter.obj.mirror_material;
-    if (mirror_level < conf.max_mirror_level &&
+    mirror_factor = inter.obj->mirror_material;
+    if (mirror_level < conf->max_mirror_level &&
         mirror_factor > 0.0)
     {
         reflection_vec = subtract_vectors(multiply_vector(2 * do_dot_product(normal_vec, rev_dir_vec), normal_vec), rev_dir_vec);
+        // Normals of some figures are not exactly unit vectors, but the figures expect normalized rays
+        normalize_vector(&reflection_vec);
         reflection_color = get_color(inter.posn, reflection_vec, mirror_level + 1, conf);
     }
     else
@@ -301,6 +273,30 @@ Color get_intersection_color(Vector eye,
     return final_color;
 }
 
+/*
+ * Returns the color that is seen from the position 'eye' when looking towards
+ * the direction 'dir_vec', once the nearest intersections on that direction
+ * are known (see 'get_nearest_intersections').
+ *
+ * eye: Position from which the scene is seen.
+ * dir_vec: Direction at which the eye is looking. This vector must be normalized.
+ * inter_list: Nearest intersections found, ordered from the nearest to the farthest.
+ * inter_length: Number of intersections found.
+ * mirror_level: Current level of reflection.
+ * conf: Configuration of the scene.
+ */
+Color get_found_color(Vector eye,
+                      Vector dir_vec,
+                      Intersection *inter_list,
+                      int inter_length,
+                      int mirror_level,
+                      const SceneConfig *conf)
+{
+	// If we don't find an intersection we return the background, otherwise we check for the intersections's color.
+	if (!inter_length) return conf->background;
+	return get_intersection_color(eye, dir_vec, inter_list, inter_length, mirror_level, 0, conf);
+}
+
 /*
  * Returns the color that is seen from the position 'eye' when looking at the
  * tridimensional scene towards the direction 'dir_vec'.
@@ -310,16 +306,12 @@ Color get_intersection_color(Vector eye,
  * mirror_level: Current level of reflection.
  * conf: Configuration of the scene.
  */
-Color get_color(Vector eye, Vector dir_vec, int mirror_level, SceneConfig conf)
+Color get_color(Vector eye, Vector dir_vec, int mirror_level, const SceneConfig *conf)
 {
-	Intersection *inter_list;
-	Color color;
-	// Get intersections on the given direction. Intersections are ordered from the nearest to the farthest.
+	Intersection inter_list[MAX_NEAREST_INTERSECTIONS];
+	// Get the nearest intersections on the given direction, ordered from the nearest to the farthest.
+	// Only the ones that can be seen through transparent objects are needed.
 	int inter_list_length;
-	inter_list = get_intersections(eye, dir_vec, &inter_list_length, conf);
-	// If we don't find an intersection we return the background, otherwise we check for the intersections's color.
-	if (!inter_list) return conf.background;
-	color = get_intersection_color(eye, dir_vec, inter_list, inter_list_length, mirror_level, 0, conf);
-	free(inter_list);
-	return color;
+	inter_list_length = get_nearest_intersections(eye, dir_vec, conf->nearest_inters_length, inter_list, conf);
+	return get_found_color(eye, dir_vec, inter_list, inter_list_length, mirror_level, conf);
 }
@@ -18,9 +18,9 @@ typedef struct
 {
     Color color;
 	Vector anchor;
-	long double const_att_factor;
-	long double lin_att_factor;
-	long double expo_att_factor;
+	Real const_att_factor;
+	Real lin_att_factor;
+	Real expo_att_factor;
 } Light;
 
 #endif
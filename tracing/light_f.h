@@ -3,7 +3,14 @@
 
 #include "../scene_config.h"
 #include "vector.h"
+#include "intersection.h"
 
-Color get_color(Vector eye, Vector dir_vec, int mirror_level, SceneConfig conf);
+Color get_found_color(Vector eye,
+                      Vector dir_vec,
+                      Intersection *inter_list,
+                      int inter_length,
+                      int mirror_level,
+                      const SceneConfig *conf);
+Color get_color(Vector eye, Vector dir_vec, int mirror_level, const SceneConfig *conf);
 
 #endif
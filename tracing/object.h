@@ -2,14 +2,59 @@
 #define OBJECT_H
 
 #include "color.h"
+#include "bounding_box.h"
 #include "../figures/plane.h"
 
+// Maximum number of intersections that a ray can have with a single figure
+#define MAX_FIGURE_INTERSECTIONS 2
+
+/*
+ * List of figure types, with the name used by the functions of each figure:
+ *      - get_<name>_intersection: Calculates the intersections of a ray with an object of the type.
+ *          - First parameter: Position from which the ray is thrown.
+ *          - Second parameter: Direction towards which the ray is thrown. Must be normalized.
+ *          - Third parameter: A pointer to the object itself.
+ *          - Fourth parameter: Output list (of Intersection structs) where the intersections are written. It
+ *                              must have space for MAX_FIGURE_INTERSECTIONS intersections.
+ *          - Returns: The number of intersections found.
+ *      - get_<name>_normal_vector: Returns the normal vector of the figure on a given position.
+ *          - First parameter: Position at which the normal is being calculated.
+ *          - Second parameter: Pointer to the figure.
+ *          - Third parameter: Primitive of the figure where the position is (see Intersection).
+ *          - Returns: The normal vector (The vector is normalized).
+ *      - get_<name>_bounds: Calculates the box that encloses the figure.
+ *          - First parameter: Pointer to the figure.
+ *          - Second parameter: Output parameter for the box of the figure.
+ *          - Returns: True if the figure is bounded. Unbounded figures (like planes) return false.
+ * The figure functions are called through a switch over this list (see figure.c), so adding a
+ * figure type only needs a new entry here, besides its loader.
+ */
+#define FIGURE_TYPE_LIST(FIGURE) \
+    FIGURE(SPHERE, sphere) \
+    FIGURE(PLANE, plane) \
+    FIGURE(POLYGON, polygon) \
+    FIGURE(DISC, disc) \
+    FIGURE(CYLINDER, cylinder) \
+    FIGURE(CONE, cone) \
+    FIGURE(MESH, mesh) \
+    FIGURE(INSTANCE, instance) \
+    FIGURE(HEIGHTFIELD, heightfield) \
+    FIGURE(PARTICLES, particles)
+
+#define FIGURE_TYPE_VALUE(type, name) FIGURE_##type,
+
+// Type of the figure of an object (FIGURE_SPHERE, FIGURE_PLANE, etc)
+typedef enum
+{
+    FIGURE_TYPE_LIST(FIGURE_TYPE_VALUE)
+} FigureType;
+
 /*
  * Represents an object in the scene
  *
  * color: Color of the object.
- * figure: Pointer to the specific figure of the object. Possible figures:
- *      - Sphere
+ * figure: Pointer to the specific figure of the object. Its struct depends on the type.
+ * type: Type of the figure of the object.
  * light_material: Factor for how much the material is affected by the light. Value between 0 and 1.
  * light_ambiental: Factor for how much the ambiental light affects the object. Value between 0 and 1.
  * specular_material: Factor for how much the material is affected by specular light. Value between 0 and 1.
@@ -19,32 +64,24 @@
  * specular_pow: Factor for how big is the specular light spot. The larger the factor, the bigger the spot.
  * cutting_planes: Planes that cut the object.
  * cutting_planes_length: Number of planes that cut the object.
- * get_intersections: Calculates the intersections of a ray with the object.
- *      - First parameter: Position from which the ray is thrown.
- *      - Second parameter: Direction towards which the ray is thrown. Must be normalized.
- *      - Third parameter: A pointer to the object itself.
- *      - Fourth parameter: Outuput parameter for the number of intersections found.
- *      - Returns: The intersections, if any. Otherwise, it retuns NULL.
- * get_normal_vector: Returns the normal vector of object's figure on a given position.
- *      - First parameter: Position at which the normal is being calculated.
- *      - Second parameter: Pointer to the object's figure.
- *      - Returns: The normal vector (The vector is normalized).
+ * ignores_lights: True if the light sources don't change the color of the object (its light and specular
+ *                 materials are 0), so no shadow rays are thrown for it. Set by the scene optimizer.
  */
 typedef struct
 {
 	Color color;
 	void* figure;
-	long double light_material;
-	long double light_ambiental;
-	long double specular_material;
-	long double mirror_material;
-	long double transparency_material;
-	long double translucency_material;
-	long double specular_pow;
+	FigureType type;
+	Real light_material;
+	Real light_ambiental;
+	Real specular_material;
+	Real mirror_material;
+	Real transparency_material;
+	Real translucency_material;
+	Real specular_pow;
 	Plane *cutting_planes;
 	int cutting_planes_length;
-	void* (*get_intersections) (Vector, Vector, void*, int*);
-	Vector (*get_normal_vector) (Vector, void*);
+	int ignores_lights;
 } Object;
 
 #endif
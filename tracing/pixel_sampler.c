@@ -0,0 +1,101 @@
+/* pixel_sampler.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Places the samples of a pixel when every pixel throws the same number of
+ * rays. The samples only depend on the pixel and the sample number, so the
+ * image doesn't depend on the number of threads that paint it.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "real.h"
+#include "../figures/coord_2d.h"
+#include "pixel_sampler.h"
+
+// Steps of the R2 sequence on each axis: 1/g and 1/g^2, where g is the plastic number
+#define R2_STEP_U 0.7548776662466927
+#define R2_STEP_V 0.5698402909980532
+
+// Methods
+
+/*
+ * Scrambles the bits of an integer. Close integers give unrelated results.
+ *
+ * value: Integer that is scrambled.
+ */
+unsigned int hash_integer(unsigned int value)
+{
+    value ^= value >> 16;
+    value *= 0x7feb352dU;
+    value ^= value >> 15;
+    value *= 0x846ca68bU;
+    value ^= value >> 16;
+    return value;
+}
+
+/*
+ * Returns a pseudo random number between 0 (included) and 1 (not included),
+ * which always is the same for the same seed.
+ *
+ * seed: Seed of the number.
+ */
+Real get_random_fraction(unsigned int seed)
+{
+    return (hash_integer(seed) >> 8) / 16777216.0;
+}
+
+/*
+ * Moves a coordinate of a sample, uniformly spread over the pixel, so the
+ * samples are spread as the tent filter weighs them (from half a pixel before
+ * the pixel to half a pixel after it, denser towards the center).
+ *
+ * value: Coordinate of the sample, between 0 and 1.
+ */
+Real apply_tent_filter(Real value)
+{
+    if(value < 0.5) return real_sqrt(2 * value) - 0.5;
+    return 1.5 - real_sqrt(2 - 2 * value);
+}
+
+/*
+ * Returns a sample of a pixel, as the distance from the upper left corner of
+ * the pixel (in pixels). The samples are spread by the reconstruction filter,
+ * so they all weigh the same, and the pixel color is their average.
+ *
+ * w_index: Horizontal position of the pixel in the image.
+ * h_index: Vertical position of the pixel in the image.
+ * sample_i: Number of the sample, from 0 to 'samples_length' - 1.
+ * samples_length: Number of samples of each pixel.
+ * pattern: Pattern of the samples.
+ * filter: Reconstruction filter.
+ */
+Coord2D get_pixel_sample(int w_index, int h_index, int sample_i, int samples_length, SamplePattern pattern, PixelFilter filter)
+{
+    Coord2D sample;
+    unsigned int pixel_seed;
+    int grid_size;
+
+    pixel_seed = hash_integer(hash_integer(w_index) + h_index) * 2 * samples_length;
+    if(pattern == SAMPLE_PATTERN_STRATIFIED)
+    {
+        grid_size = (int) round(sqrt(samples_length));
+        sample.u = (sample_i % grid_size + get_random_fraction(pixel_seed + 2 * sample_i)) / grid_size;
+        sample.v = (sample_i / grid_size + get_random_fraction(pixel_seed + 2 * sample_i + 1)) / grid_size;
+    }
+    else
+    {
+        // The whole sequence is shifted by the same random amount, so it keeps its spacing
+        sample.u = 0.5 + get_random_fraction(pixel_seed) + sample_i * R2_STEP_U;
+        sample.v = 0.5 + get_random_fraction(pixel_seed + 1) + sample_i * R2_STEP_V;
+        sample.u -= real_floor(sample.u);
+        sample.v -= real_floor(sample.v);
+    }
+    if(filter == PIXEL_FILTER_TENT)
+    {
+        sample.u = apply_tent_filter(sample.u);
+        sample.v = apply_tent_filter(sample.v);
+    }
+    return sample;
+}
@@ -0,0 +1,33 @@
+#ifndef PIXEL_SAMPLER_H
+#define PIXEL_SAMPLER_H
+
+#include "real.h"
+#include "../figures/coord_2d.h"
+
+/*
+ * Patterns of the samples of a pixel when every pixel throws the same number of rays:
+ *      - SAMPLE_PATTERN_STRATIFIED: The pixel is split in a grid of equal cells, with a random sample in each one.
+ *                                   The number of samples must be a square.
+ *      - SAMPLE_PATTERN_R2: Samples of the R2 low discrepancy sequence, shifted randomly for each pixel.
+ */
+typedef enum
+{
+    SAMPLE_PATTERN_STRATIFIED,
+    SAMPLE_PATTERN_R2
+} SamplePattern;
+
+/*
+ * Reconstruction filters of the samples of a pixel:
+ *      - PIXEL_FILTER_BOX: The samples cover the pixel, and all of them weigh the same.
+ *      - PIXEL_FILTER_TENT: The samples cover the pixel and half of its neighbours, and weigh less as they get
+ *                           away from the pixel center (linearly, down to 0 one pixel away).
+ */
+typedef enum
+{
+    PIXEL_FILTER_BOX,
+    PIXEL_FILTER_TENT
+} PixelFilter;
+
+Coord2D get_pixel_sample(int w_index, int h_index, int sample_i, int samples_length, SamplePattern pattern, PixelFilter filter);
+
+#endif
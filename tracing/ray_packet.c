@@ -0,0 +1,477 @@
+/* ray_packet.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Traces packets of coherent rays (like the primary rays of a pixel row)
+ * through the object hierarchy. Boxes, spheres and planes are tested against
+ * all the rays of a packet at once, with AVX2 instructions when the CPU
+ * supports them. The other figures are tested one ray at a time.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../scene_config.h"
+#include "../figures/sphere.h"
+#include "../figures/plane.h"
+#include "vector.h"
+#include "object.h"
+#include "intersection.h"
+#include "bounding_box.h"
+#include "bvh.h"
+#include "ray_packet.h"
+
+// The AVX2 functions are only built for double precision on x86 processors
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(REAL_FLOAT) && !defined(REAL_LONG_DOUBLE)
+#define PACKET_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+ * Functions that test every ray of a packet at once. Every instruction set has
+ * its own functions, and the best ones supported by the CPU are picked at
+ * runtime. They all return the same values.
+ *
+ * hit_box: Returns a bit mask with the rays that hit the box before their
+ *          maximum distance (third parameter).
+ * hit_sphere: Solves the cuadratic function of the sphere for each ray, and
+ *          returns a bit mask with the rays that have a solution. Both
+ *          solutions are stored on the output parameters, the lowest first.
+ * hit_plane: Finds the distance from the eye to the plane for each ray, and
+ *          returns a bit mask with the rays that aren't paralell to the plane.
+ */
+typedef struct
+{
+    int (*hit_box) (const RayPacket*, const BoundingBox*, const Real*);
+    int (*hit_sphere) (const RayPacket*, const Sphere*, Real*, Real*);
+    int (*hit_plane) (const RayPacket*, const Plane*, Real*);
+} PacketKernels;
+
+// Functions used to trace the packets. Set by 'init_ray_packets'.
+static PacketKernels PACKET_KERNELS;
+
+// Methods
+
+/*
+ * Tests a box against every ray of a packet, one ray at a time. Returns a bit
+ * mask with the rays that hit it.
+ *
+ * packet: Rays tested against the box.
+ * box: Box being tested.
+ * max_distance: Distance beyond which each ray ignores the box.
+ */
+int hit_packet_box(const RayPacket *packet, const BoundingBox *box, const Real *max_distance)
+{
+    Real t1, t2, t_near, t_far;
+    int lane, hits;
+
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane++)
+    {
+        t_near = 0.0;
+        t_far = max_distance[lane];
+        t1 = (box->min.x - packet->eye.x) * packet->inv_x[lane];
+        t2 = (box->max.x - packet->eye.x) * packet->inv_x[lane];
+        t_near = real_max(t_near, real_min(t1, t2));
+        t_far = real_min(t_far, real_max(t1, t2));
+        t1 = (box->min.y - packet->eye.y) * packet->inv_y[lane];
+        t2 = (box->max.y - packet->eye.y) * packet->inv_y[lane];
+        t_near = real_max(t_near, real_min(t1, t2));
+        t_far = real_min(t_far, real_max(t1, t2));
+        t1 = (box->min.z - packet->eye.z) * packet->inv_z[lane];
+        t2 = (box->max.z - packet->eye.z) * packet->inv_z[lane];
+        t_near = real_max(t_near, real_min(t1, t2));
+        t_far = real_min(t_far, real_max(t1, t2));
+        if(t_near <= t_far) hits |= 1 << lane;
+    }
+    return hits;
+}
+
+/*
+ * Solves the cuadratic function of a sphere for every ray of a packet, one
+ * ray at a time. It follows the same steps as 'get_sphere_intersection'.
+ *
+ * packet: Rays tested against the sphere.
+ * sphere: Sphere being tested.
+ * near_distances: Output parameter for the lowest solution of each ray.
+ * far_distances: Output parameter for the highest solution of each ray.
+ */
+int hit_packet_sphere(const RayPacket *packet, const Sphere *sphere, Real *near_distances, Real *far_distances)
+{
+    Vector inter_diff;
+    Real b, c, discr, sqrt_discr;
+    int lane, hits;
+
+    // All the rays share the eye, so only 'b' changes between them
+    inter_diff = subtract_vectors(packet->eye, sphere->center);
+    c = inter_diff.x * inter_diff.x +
+        inter_diff.y * inter_diff.y +
+        inter_diff.z * inter_diff.z -
+        sphere->radius_pow;
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane++)
+    {
+        b = 2.0 * (packet->dir_x[lane] * inter_diff.x +
+                   packet->dir_y[lane] * inter_diff.y +
+                   packet->dir_z[lane] * inter_diff.z);
+        discr = b * b - 4 * c;
+        if(discr < 0) continue;
+        sqrt_discr = real_sqrt(discr);
+        near_distances[lane] = (- b - sqrt_discr) / 2;
+        far_distances[lane] = (- b + sqrt_discr) / 2;
+        hits |= 1 << lane;
+    }
+    return hits;
+}
+
+/*
+ * Finds the distance to a plane for every ray of a packet, one ray at a time.
+ * It follows the same steps as 'get_embedded_plane_intersection'.
+ *
+ * packet: Rays tested against the plane.
+ * plane: Plane being tested.
+ * distances: Output parameter for the distance of each ray to the plane.
+ */
+int hit_packet_plane(const RayPacket *packet, const Plane *plane, Real *distances)
+{
+    Real eye_factor, dir_factor;
+    int lane, hits;
+
+    eye_factor = - (plane->direction.x * packet->eye.x +
+                    plane->direction.y * packet->eye.y +
+                    plane->direction.z * packet->eye.z +
+                    plane->offset);
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane++)
+    {
+        dir_factor = plane->direction.x * packet->dir_x[lane] +
+                     plane->direction.y * packet->dir_y[lane] +
+                     plane->direction.z * packet->dir_z[lane];
+        if(!dir_factor) continue;
+        distances[lane] = eye_factor / dir_factor;
+        hits |= 1 << lane;
+    }
+    return hits;
+}
+
+#ifdef PACKET_AVX2
+
+/*
+ * Clips the near and far distances of 4 rays of a packet with the slab of a
+ * box on one axis.
+ *
+ * box_min: Lowest coordinate of the box on the axis.
+ * box_max: Highest coordinate of the box on the axis.
+ * eye: Coordinate of the eye on the axis.
+ * inv_dir: Inverse directions of the 4 rays on the axis.
+ * t_near: Input/Output parameter for the near distances.
+ * t_far: Input/Output parameter for the far distances.
+ */
+__attribute__((target("avx2")))
+static inline void clip_box_axis_avx2(Real box_min, Real box_max, Real eye, const Real *inv_dir, __m256d *t_near, __m256d *t_far)
+{
+    __m256d inv_dir_4, t1, t2;
+    inv_dir_4 = _mm256_loadu_pd(inv_dir);
+    t1 = _mm256_mul_pd(_mm256_set1_pd(box_min - eye), inv_dir_4);
+    t2 = _mm256_mul_pd(_mm256_set1_pd(box_max - eye), inv_dir_4);
+    *t_near = _mm256_max_pd(*t_near, _mm256_min_pd(t1, t2));
+    *t_far = _mm256_min_pd(*t_far, _mm256_max_pd(t1, t2));
+}
+
+/*
+ * AVX2 version of 'hit_packet_box'. It tests 4 rays at a time.
+ */
+__attribute__((target("avx2")))
+int hit_packet_box_avx2(const RayPacket *packet, const BoundingBox *box, const Real *max_distance)
+{
+    __m256d t_near, t_far;
+    int lane, hits;
+
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane += 4)
+    {
+        t_near = _mm256_setzero_pd();
+        t_far = _mm256_loadu_pd(&max_distance[lane]);
+        clip_box_axis_avx2(box->min.x, box->max.x, packet->eye.x, &packet->inv_x[lane], &t_near, &t_far);
+        clip_box_axis_avx2(box->min.y, box->max.y, packet->eye.y, &packet->inv_y[lane], &t_near, &t_far);
+        clip_box_axis_avx2(box->min.z, box->max.z, packet->eye.z, &packet->inv_z[lane], &t_near, &t_far);
+        hits |= _mm256_movemask_pd(_mm256_cmp_pd(t_near, t_far, _CMP_LE_OQ)) << lane;
+    }
+    return hits;
+}
+
+/*
+ * AVX2 version of 'hit_packet_sphere'. It solves 4 rays at a time.
+ */
+__attribute__((target("avx2")))
+int hit_packet_sphere_avx2(const RayPacket *packet, const Sphere *sphere, Real *near_distances, Real *far_distances)
+{
+    Vector inter_diff;
+    Real c;
+    __m256d b, discr, sqrt_discr, neg_b, two;
+    int lane, hits;
+
+    inter_diff = subtract_vectors(packet->eye, sphere->center);
+    c = inter_diff.x * inter_diff.x +
+        inter_diff.y * inter_diff.y +
+        inter_diff.z * inter_diff.z -
+        sphere->radius_pow;
+    two = _mm256_set1_pd(2.0);
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane += 4)
+    {
+        b = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(_mm256_loadu_pd(&packet->dir_x[lane]), _mm256_set1_pd(inter_diff.x)),
+                _mm256_mul_pd(_mm256_loadu_pd(&packet->dir_y[lane]), _mm256_set1_pd(inter_diff.y))),
+                _mm256_mul_pd(_mm256_loadu_pd(&packet->dir_z[lane]), _mm256_set1_pd(inter_diff.z)));
+        b = _mm256_mul_pd(_mm256_set1_pd(2.0), b);
+        discr = _mm256_sub_pd(_mm256_mul_pd(b, b), _mm256_set1_pd(4 * c));
+        hits |= _mm256_movemask_pd(_mm256_cmp_pd(discr, _mm256_setzero_pd(), _CMP_GE_OQ)) << lane;
+        // Rays without a solution get a NaN that is never used
+        sqrt_discr = _mm256_sqrt_pd(discr);
+        neg_b = _mm256_xor_pd(b, _mm256_set1_pd(-0.0));
+        _mm256_storeu_pd(&near_distances[lane], _mm256_div_pd(_mm256_sub_pd(neg_b, sqrt_discr), two));
+        _mm256_storeu_pd(&far_distances[lane], _mm256_div_pd(_mm256_add_pd(neg_b, sqrt_discr), two));
+    }
+    return hits;
+}
+
+/*
+ * AVX2 version of 'hit_packet_plane'. It tests 4 rays at a time.
+ */
+__attribute__((target("avx2")))
+int hit_packet_plane_avx2(const RayPacket *packet, const Plane *plane, Real *distances)
+{
+    Real eye_factor;
+    __m256d dir_factor;
+    int lane, hits;
+
+    eye_factor = - (plane->direction.x * packet->eye.x +
+                    plane->direction.y * packet->eye.y +
+                    plane->direction.z * packet->eye.z +
+                    plane->offset);
+    hits = 0;
+    for(lane = 0; lane < PACKET_SIZE; lane += 4)
+    {
+        dir_factor = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(_mm256_set1_pd(plane->direction.x), _mm256_loadu_pd(&packet->dir_x[lane])),
+                _mm256_mul_pd(_mm256_set1_pd(plane->direction.y), _mm256_loadu_pd(&packet->dir_y[lane]))),
+                _mm256_mul_pd(_mm256_set1_pd(plane->direction.z), _mm256_loadu_pd(&packet->dir_z[lane])));
+        hits |= _mm256_movemask_pd(_mm256_cmp_pd(dir_factor, _mm256_setzero_pd(), _CMP_NEQ_OQ)) << lane;
+        _mm256_storeu_pd(&distances[lane], _mm256_div_pd(_mm256_set1_pd(eye_factor), dir_factor));
+    }
+    return hits;
+}
+
+#endif
+
+/*
+ * Picks the functions used to trace the packets, according to the instruction
+ * sets supported by the CPU. It must be called before tracing any packet, and
+ * returns the name of the instruction set that will be used.
+ */
+const char* init_ray_packets()
+{
+    PACKET_KERNELS.hit_box = &hit_packet_box;
+    PACKET_KERNELS.hit_sphere = &hit_packet_sphere;
+    PACKET_KERNELS.hit_plane = &hit_packet_plane;
+#ifdef PACKET_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        PACKET_KERNELS.hit_box = &hit_packet_box_avx2;
+        PACKET_KERNELS.hit_sphere = &hit_packet_sphere_avx2;
+        PACKET_KERNELS.hit_plane = &hit_packet_plane_avx2;
+        return "AVX2";
+    }
+#endif
+    return "none";
+}
+
+/*
+ * Adds a ray to a packet. The unused lanes of the packet repeat the new ray,
+ * so every lane can be traced.
+ *
+ * packet: Packet to which the ray is added. It must not be full.
+ * dir_vec: Direction of the ray. This vector must be normalized.
+ */
+void add_packet_ray(RayPacket *packet, Vector dir_vec)
+{
+    Vector inv_dir_vec;
+    int lane;
+
+    inv_dir_vec = get_inverse_direction(dir_vec);
+    for(lane = packet->length++; lane < PACKET_SIZE; lane++)
+    {
+        packet->dir_x[lane] = dir_vec.x;
+        packet->dir_y[lane] = dir_vec.y;
+        packet->dir_z[lane] = dir_vec.z;
+        packet->inv_x[lane] = inv_dir_vec.x;
+        packet->inv_y[lane] = inv_dir_vec.y;
+        packet->inv_z[lane] = inv_dir_vec.z;
+    }
+}
+
+/*
+ * Returns the direction of one of the rays of a packet.
+ *
+ * packet: Packet that holds the ray.
+ * lane: Position of the ray in the packet.
+ */
+Vector get_packet_ray(const RayPacket *packet, int lane)
+{
+    return (Vector){ .x = packet->dir_x[lane], .y = packet->dir_y[lane], .z = packet->dir_z[lane] };
+}
+
+/*
+ * Adds the intersection of a ray of a packet at the given distance to the
+ * nearest intersections of the ray.
+ *
+ * packet: Packet that holds the ray.
+ * lane: Position of the ray in the packet.
+ * obj: Object that was hit.
+ * distance: Distance from the eye to the intersection.
+ * max_length: Maximum number of intersections kept for each ray.
+ * inter_list: Nearest intersections of the ray.
+ * length: Input/Output parameter for the length of the list.
+ * max_distance: Input/Output parameter for the search distance of the ray.
+ */
+void add_packet_hit(const RayPacket *packet,
+                    int lane,
+                    Object *obj,
+                    Real distance,
+                    int max_length,
+                    Intersection *inter_list,
+                    int *length,
+                    Real *max_distance)
+{
+    Intersection inter;
+    if(distance <= INTER_EPSILON) return;
+    inter.distance = distance;
+    inter.posn = get_ray_position(packet->eye, get_packet_ray(packet, lane), distance);
+    inter.obj = obj;
+    inter.is_valid = 1;
+    inter.primitive = 0;
+    insert_nearest_intersection(inter, inter_list, length, max_length);
+    if(*length == max_length) *max_distance = inter_list[max_length - 1].distance;
+}
+
+/*
+ * Adds the intersections of some rays of a packet with an object to their
+ * nearest intersections. Spheres and planes without cutting planes are
+ * tested against all the rays at once. Other objects are tested one ray at a
+ * time.
+ *
+ * packet: Rays tested against the object.
+ * lanes: Bit mask with the rays of the packet that must be tested.
+ * obj: Object being tested.
+ * max_length: Maximum number of intersections kept for each ray.
+ * inter_lists: Nearest intersections of each ray.
+ * lengths: Input/Output parameter for the length of each list.
+ * max_distances: Input/Output parameter for the search distance of each ray.
+ */
+void add_packet_object_intersections(const RayPacket *packet,
+                                     int lanes,
+                                     Object *obj,
+                                     int max_length,
+                                     Intersection inter_lists[][MAX_NEAREST_INTERSECTIONS],
+                                     int *lengths,
+                                     Real *max_distances)
+{
+    Real near_distances[PACKET_SIZE], far_distances[PACKET_SIZE];
+    int lane, hits;
+
+    if(!obj->cutting_planes_length && obj->type == FIGURE_SPHERE)
+    {
+        hits = PACKET_KERNELS.hit_sphere(packet, (Sphere*) obj->figure, near_distances, far_distances) & lanes;
+        for(lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if(!(hits & (1 << lane))) continue;
+            // Same cases as 'do_cuadratic_function'
+            if(near_distances[lane] > 0 && far_distances[lane] > 0)
+            {
+                add_packet_hit(packet, lane, obj, near_distances[lane], max_length, inter_lists[lane], &lengths[lane], &max_distances[lane]);
+                if(near_distances[lane] != far_distances[lane])
+                    add_packet_hit(packet, lane, obj, far_distances[lane], max_length, inter_lists[lane], &lengths[lane], &max_distances[lane]);
+            }
+            else if(near_distances[lane] >= 0 || far_distances[lane] >= 0)
+            {   // The eye is inside the sphere
+                add_packet_hit(packet, lane, obj, far_distances[lane], max_length, inter_lists[lane], &lengths[lane], &max_distances[lane]);
+            }
+        }
+    }
+    else if(!obj->cutting_planes_length && obj->type == FIGURE_PLANE)
+    {
+        hits = PACKET_KERNELS.hit_plane(packet, (Plane*) obj->figure, near_distances) & lanes;
+        for(lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if((hits & (1 << lane)) && near_distances[lane] > 0)
+                add_packet_hit(packet, lane, obj, near_distances[lane], max_length, inter_lists[lane], &lengths[lane], &max_distances[lane]);
+        }
+    }
+    else
+    {
+        for(lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if(lanes & (1 << lane))
+                add_nearest_object_intersections(packet->eye, get_packet_ray(packet, lane), obj, inter_lists[lane],
+                                                 &lengths[lane], max_length, &max_distances[lane]);
+        }
+    }
+}
+
+/*
+ * Obtains the 'max_length' nearest intersections of every ray of a packet, as
+ * 'get_nearest_intersections' does for a single ray. The hierarchy is walked
+ * once for the whole packet, and a node is skipped only when none of the rays
+ * hit its box.
+ *
+ * packet: Rays whose intersections are searched.
+ * max_length: Number of intersections that are needed for each ray.
+ * inter_lists: Output lists of the nearest intersections of each ray.
+ * lengths: Output parameter for the number of intersections found by each ray.
+ * conf: Configuration of the scene.
+ */
+void get_packet_nearest_intersections(const RayPacket *packet,
+                                      int max_length,
+                                      Intersection inter_lists[][MAX_NEAREST_INTERSECTIONS],
+                                      int *lengths,
+                                      const SceneConfig *conf)
+{
+    BvhNode *node;
+    Real max_distances[PACKET_SIZE];
+    int lanes, lane, hits, obj_index, node_i, stack_length;
+    int node_stack[BVH_MAX_DEPTH + 1];
+
+    lanes = (1 << packet->length) - 1;
+    for(lane = 0; lane < PACKET_SIZE; lane++)
+    {
+        lengths[lane] = 0;
+        max_distances[lane] = INFINITY;
+    }
+    for(obj_index = 0; obj_index < conf->unbounded_objs_length; obj_index++)
+    {
+        add_packet_object_intersections(packet, lanes, &conf->objs[conf->unbounded_objs[obj_index]],
+                                        max_length, inter_lists, lengths, max_distances);
+    }
+    stack_length = 0;
+    if(conf->objs_bvh.nodes_length) node_stack[stack_length++] = 0;
+    while(stack_length > 0)
+    {
+        node_i = node_stack[--stack_length];
+        node = &conf->objs_bvh.nodes[node_i];
+        hits = PACKET_KERNELS.hit_box(packet, &node->box, max_distances) & lanes;
+        if(!hits) continue;
+        if(node->length)
+        {
+            for(obj_index = node->first; obj_index < node->first + node->length; obj_index++)
+                add_packet_object_intersections(packet, hits, &conf->objs[conf->objs_bvh.indexes[obj_index]],
+                                                max_length, inter_lists, lengths, max_distances);
+        }
+        else
+        {
+            node_stack[stack_length++] = node->right_child;
+            node_stack[stack_length++] = node_i + 1;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "vector.h"
+#include "intersection.h"
+#include "../scene_config.h"
+
+// Number of rays traced together in a packet
+#define PACKET_SIZE 8
+
+/*
+ * Represents a group of rays thrown from the same position, traced together
+ * through the scene. The directions are stored per axis, so the same
+ * operation can be applied to several rays at once.
+ *
+ * eye: Position from which all the rays are thrown.
+ * dir_x, dir_y, dir_z: Directions of the rays. They must be normalized.
+ * inv_x, inv_y, inv_z: Inverse directions of the rays (see get_inverse_direction).
+ * length: Number of rays in the packet. Unused lanes repeat the last ray.
+ */
+typedef struct
+{
+    Vector eye;
+    Real dir_x[PACKET_SIZE];
+    Real dir_y[PACKET_SIZE];
+    Real dir_z[PACKET_SIZE];
+    Real inv_x[PACKET_SIZE];
+    Real inv_y[PACKET_SIZE];
+    Real inv_z[PACKET_SIZE];
+    int length;
+} RayPacket;
+
+const char* init_ray_packets();
+void add_packet_ray(RayPacket *packet, Vector dir_vec);
+Vector get_packet_ray(const RayPacket *packet, int lane);
+void get_packet_nearest_intersections(const RayPacket *packet,
+                                      int max_length,
+                                      Intersection inter_lists[][MAX_NEAREST_INTERSECTIONS],
+                                      int *lengths,
+                                      const SceneConfig *conf);
+
+#endif
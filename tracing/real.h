@@ -0,0 +1,65 @@
+#ifndef REAL_H
+#define REAL_H
+
+#include <math.h>
+#include <float.h>
+
+/*
+ * Real number type used by the whole tracer (vectors, colors, figures, etc).
+ * The precision is chosen at build time:
+ *      - REAL_FLOAT: Single precision. Fastest, meant for previews.
+ *      - REAL_LONG_DOUBLE: Extended precision. Slowest, uses x87 code on x86.
+ *      - Otherwise: Double precision.
+ * Every math function used with real numbers must be one of the 'real_'
+ * macros, so it matches the chosen precision.
+ *
+ * REAL_TOLERANCE: Distance below which two positions are considered the same.
+ *                 It is used to discard the intersections of a ray with the
+ *                 surface it was thrown from, so it grows when the
+ *                 precision drops.
+ */
+#if defined(REAL_FLOAT)
+typedef float Real;
+#define REAL_MAX FLT_MAX
+#define REAL_TOLERANCE 0.01
+#define real_sqrt(x) sqrtf(x)
+#define real_pow(x, y) powf(x, y)
+#define real_abs(x) fabsf(x)
+#define real_min(x, y) fminf(x, y)
+#define real_max(x, y) fmaxf(x, y)
+#define real_sin(x) sinf(x)
+#define real_cos(x) cosf(x)
+#define real_floor(x) floorf(x)
+#define real_round(x) roundf(x)
+#define real_cbrt(x) cbrtf(x)
+#elif defined(REAL_LONG_DOUBLE)
+typedef long double Real;
+#define REAL_MAX LDBL_MAX
+#define REAL_TOLERANCE 0.001
+#define real_sqrt(x) sqrtl(x)
+#define real_pow(x, y) powl(x, y)
+#define real_abs(x) fabsl(x)
+#define real_min(x, y) fminl(x, y)
+#define real_max(x, y) fmaxl(x, y)
+#define real_sin(x) sinl(x)
+#define real_cos(x) cosl(x)
+#define real_floor(x) floorl(x)
+#define real_round(x) roundl(x)
+#define real_cbrt(x) cbrtl(x)
+#else
+typedef double Real;
+#define REAL_MAX DBL_MAX
+#define REAL_TOLERANCE 0.001
+#define real_sqrt(x) sqrt(x)
+#define real_pow(x, y) pow(x, y)
+#define real_abs(x) fabs(x)
+#define real_min(x, y) fmin(x, y)
+#define real_max(x, y) fmax(x, y)
+#define real_sin(x) sin(x)
+#define real_cos(x) cos(x)
+#define real_floor(x) floor(x)
+#define real_round(x) round(x)
+#define real_cbrt(x) cbrt(x)
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+/* transform.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Contains the functions for affine transforms.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "vector.h"
+#include "bounding_box.h"
+#include "transform.h"
+
+// Methods
+
+/*
+ * Returns the transform that scales, then rotates and then translates a
+ * position.
+ *
+ * translation: Offset of the transform.
+ * rotation: Angles (in degrees) rotated around the X, Y and Z axes, in that order.
+ * scale: Scale factor of each axis. None of them can be 0.
+ */
+Transform build_transform(Vector translation, Vector rotation, Vector scale)
+{
+    Transform transform;
+    Real sin_x, cos_x, sin_y, cos_y, sin_z, cos_z;
+
+    sin_x = real_sin(rotation.x * M_PI / 180.0);
+    cos_x = real_cos(rotation.x * M_PI / 180.0);
+    sin_y = real_sin(rotation.y * M_PI / 180.0);
+    cos_y = real_cos(rotation.y * M_PI / 180.0);
+    sin_z = real_sin(rotation.z * M_PI / 180.0);
+    cos_z = real_cos(rotation.z * M_PI / 180.0);
+    // Rotation Z * Rotation Y * Rotation X * Scale
+    transform.rows[0].x = cos_z * cos_y * scale.x;
+    transform.rows[0].y = (cos_z * sin_y * sin_x - sin_z * cos_x) * scale.y;
+    transform.rows[0].z = (cos_z * sin_y * cos_x + sin_z * sin_x) * scale.z;
+    transform.rows[1].x = sin_z * cos_y * scale.x;
+    transform.rows[1].y = (sin_z * sin_y * sin_x + cos_z * cos_x) * scale.y;
+    transform.rows[1].z = (sin_z * sin_y * cos_x - cos_z * sin_x) * scale.z;
+    transform.rows[2].x = - sin_y * scale.x;
+    transform.rows[2].y = cos_y * sin_x * scale.y;
+    transform.rows[2].z = cos_y * cos_x * scale.z;
+    transform.translation = translation;
+    return transform;
+}
+
+/*
+ * Returns the transform that undoes the given one. The linear part of the
+ * transform must not be singular.
+ *
+ * transform: Transform that is inverted.
+ */
+Transform invert_transform(Transform transform)
+{
+    Transform inverse;
+    Vector columns[3];
+    Real inv_det;
+
+    // The columns of the inverse are the cross products of the rows
+    columns[0] = do_cross_product(transform.rows[1], transform.rows[2]);
+    columns[1] = do_cross_product(transform.rows[2], transform.rows[0]);
+    columns[2] = do_cross_product(transform.rows[0], transform.rows[1]);
+    inv_det = 1.0 / do_dot_product(transform.rows[0], columns[0]);
+    inverse.rows[0] = multiply_vector(inv_det, (Vector){ .x = columns[0].x, .y = columns[1].x, .z = columns[2].x });
+    inverse.rows[1] = multiply_vector(inv_det, (Vector){ .x = columns[0].y, .y = columns[1].y, .z = columns[2].y });
+    inverse.rows[2] = multiply_vector(inv_det, (Vector){ .x = columns[0].z, .y = columns[1].z, .z = columns[2].z });
+    inverse.translation = multiply_vector(-1.0, transform_direction(&inverse, transform.translation));
+    return inverse;
+}
+
+/*
+ * Returns the transform that applies 'inner' and then 'outer'.
+ *
+ * outer: Transform applied last.
+ * inner: Transform applied first.
+ */
+Transform combine_transforms(Transform outer, Transform inner)
+{
+    Transform result;
+    Vector columns[3];
+    int row_i;
+
+    columns[0] = (Vector){ .x = inner.rows[0].x, .y = inner.rows[1].x, .z = inner.rows[2].x };
+    columns[1] = (Vector){ .x = inner.rows[0].y, .y = inner.rows[1].y, .z = inner.rows[2].y };
+    columns[2] = (Vector){ .x = inner.rows[0].z, .y = inner.rows[1].z, .z = inner.rows[2].z };
+    for(row_i = 0; row_i < 3; row_i++)
+    {
+        result.rows[row_i].x = do_dot_product(outer.rows[row_i], columns[0]);
+        result.rows[row_i].y = do_dot_product(outer.rows[row_i], columns[1]);
+        result.rows[row_i].z = do_dot_product(outer.rows[row_i], columns[2]);
+    }
+    result.translation = transform_point(&outer, inner.translation);
+    return result;
+}
+
+/*
+ * Returns a position moved by a transform.
+ *
+ * transform: Transform applied to the position.
+ * point: Position that is transformed.
+ */
+Vector transform_point(const Transform *transform, Vector point)
+{
+    Vector result = transform_direction(transform, point);
+    result.x += transform->translation.x;
+    result.y += transform->translation.y;
+    result.z += transform->translation.z;
+    return result;
+}
+
+/*
+ * Returns a direction moved by a transform. Directions are not translated, and
+ * the result is not normalized.
+ *
+ * transform: Transform applied to the direction.
+ * dir_vec: Direction that is transformed.
+ */
+Vector transform_direction(const Transform *transform, Vector dir_vec)
+{
+    Vector result;
+    result.x = do_dot_product(transform->rows[0], dir_vec);
+    result.y = do_dot_product(transform->rows[1], dir_vec);
+    result.z = do_dot_product(transform->rows[2], dir_vec);
+    return result;
+}
+
+/*
+ * Returns a normal vector moved by a transform. Normals are multiplied by the
+ * transpose of the inverse transform, so they stay perpendicular to the surface
+ * when the scale is not uniform. The result is not normalized.
+ *
+ * inverse: Inverse of the transform applied to the surface.
+ * normal_vector: Normal vector that is transformed.
+ */
+Vector transform_normal(const Transform *inverse, Vector normal_vector)
+{
+    Vector result;
+    result = multiply_vector(normal_vector.x, inverse->rows[0]);
+    result.x += normal_vector.y * inverse->rows[1].x + normal_vector.z * inverse->rows[2].x;
+    result.y += normal_vector.y * inverse->rows[1].y + normal_vector.z * inverse->rows[2].y;
+    result.z += normal_vector.y * inverse->rows[1].z + normal_vector.z * inverse->rows[2].z;
+    return result;
+}
+
+/*
+ * Returns the smallest box that contains a transformed box.
+ *
+ * transform: Transform applied to the box.
+ * box: Box that is transformed.
+ */
+BoundingBox transform_box(const Transform *transform, BoundingBox box)
+{
+    BoundingBox result;
+    int corner_i;
+    Vector corner;
+
+    result = get_empty_box();
+    for(corner_i = 0; corner_i < 8; corner_i++)
+    {
+        corner.x = corner_i & 1 ? box.max.x : box.min.x;
+        corner.y = corner_i & 2 ? box.max.y : box.min.y;
+        corner.z = corner_i & 4 ? box.max.z : box.min.z;
+        result = add_point_to_box(result, transform_point(transform, corner));
+    }
+    return result;
+}
@@ -0,0 +1,28 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "vector.h"
+#include "bounding_box.h"
+
+/*
+ * Represents an affine transform. A point is transformed by multiplying it by
+ * the matrix, and then adding the translation.
+ *
+ * rows: Rows of the linear part of the transform (a 3x3 matrix).
+ * translation: Offset added after the linear part.
+ */
+typedef struct
+{
+	Vector rows[3];
+	Vector translation;
+} Transform;
+
+Transform build_transform(Vector translation, Vector rotation, Vector scale);
+Transform invert_transform(Transform transform);
+Transform combine_transforms(Transform outer, Transform inner);
+Vector transform_point(const Transform *transform, Vector point);
+Vector transform_direction(const Transform *transform, Vector dir_vec);
+Vector transform_normal(const Transform *inverse, Vector normal_vector);
+BoundingBox transform_box(const Transform *transform, BoundingBox box);
+
+#endif
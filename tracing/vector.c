@@ -13,15 +13,25 @@
 
 // Methods
 
+/*
+ * Returns the length of the given vector.
+ *
+ * vector: Vector whose length is calculated.
+ */
+Real get_vector_length(Vector vector)
+{
+	return real_sqrt(real_pow(vector.x, 2) + real_pow(vector.y, 2) + real_pow(vector.z, 2));
+}
+
 /*
  * Normalizes the given vector: it makes the vector length equal to 1.
  * This method returns the previous length of the vector.
  *
  * vector: Pointer to the vector that will be normalized
  */
-long double normalize_vector(Vector *vector)
+Real normalize_vector(Vector *vector)
 {
-	long double length = sqrt(pow(vector->x, 2) + pow(vector->y, 2) + pow(vector->z, 2));
+	Real length = get_vector_length(*vector);
 	vector->x = vector->x / length;
 	vector->y = vector->y / length;
 	vector->z = vector->z / length;
@@ -34,34 +44,34 @@ long double normalize_vector(Vector *vector)
  *
  * distances: Result of the function 'do_cuadratic_function'
  */
-int is_one_distance(long double *distances)
+int is_one_distance(Real *distances)
 {
     return distances[0] == distances[1];
 }
 
 /*
- * Uses a cuadratic function to return the distances between each intersection
- * and the eye, if any. Otherwise, it returns a NULL pointer. If there is only
- * one intersection, the array will contain the same distance twice. The first
- * distance is the one of the intersection that is nearest to the eye.
+ * Uses a cuadratic function to find the distances between each intersection
+ * and the eye, and returns how many different distances were found (0, 1 or
+ * 2). If there is only one intersection, the array will contain the same
+ * distance twice. The first distance is the one of the intersection that is
+ * nearest to the eye.
  * NOTE: A cuadratic function is described with the following formula
  * (A (+ and -) sqrt(B^2 - 4AC)) / 2A
  *
  * a: A term of the cuadratic function
  * b: B term of the cuadratic function
  * c: C term of the cuadratic function
+ * distances: Output array with space for 2 distances.
  */
-long double* do_cuadratic_function(long double a, long double b, long double c)
+int do_cuadratic_function(Real a, Real b, Real c, Real *distances)
 {
-	long double discr, sqrt_discr, t1, t2;
-	long double * distances;
+	Real discr, sqrt_discr, t1, t2;
 
-	discr = pow(b, 2) - 4 * a * c;
+	discr = real_pow(b, 2) - 4 * a * c;
 	// There isn't any intersection
-	if (discr < 0) return NULL;
+	if (discr < 0) return 0;
 	// Continues if there is at least one intersection
-    distances = get_memory(sizeof(long double) * 2, NULL);
-    sqrt_discr = sqrt(discr);
+    sqrt_discr = real_sqrt(discr);
     t1 = (- b - sqrt_discr) / (2 * a);
     t2 = (- b + sqrt_discr) / (2 * a);
     // Object in front of us
@@ -69,20 +79,19 @@ long double* do_cuadratic_function(long double a, long double b, long double c)
     {
         distances[0] = t1;
         distances[1] = t2;
-        return distances;
+        return is_one_distance(distances) ? 1 : 2;
     }
     // Object behind us
     else if(t1 < 0 && t2 < 0)
     {
-        free(distances);
-        return NULL;
+        return 0;
     }
     // We are inside the object!
     else
     {
         distances[0] = t2;
         distances[1] = t2;
-        return distances;
+        return 1;
     }
 }
 
@@ -94,7 +103,7 @@ long double* do_cuadratic_function(long double a, long double b, long double c)
  * dir: Direction towards which the ray is thrown.
  * distance: Length of the ray.
  */
-Vector get_ray_position(Vector anchor, Vector dir, long double distance)
+Vector get_ray_position(Vector anchor, Vector dir, Real distance)
 {
 	Vector ray_position;
 	ray_position.x = anchor.x + dir.x * distance;
@@ -125,7 +134,7 @@ Vector subtract_vectors(Vector vector, Vector subtracting_vector)
  * scalar_value: Value by which all the vector coordinates will be multiplied.
  * vector: Vector that will be multiplied.
  */
-Vector multiply_vector(long double scalar_value, Vector vector)
+Vector multiply_vector(Real scalar_value, Vector vector)
 {
 	Vector new_vector = vector;
 	new_vector.x *= scalar_value;
@@ -142,7 +151,7 @@ Vector multiply_vector(long double scalar_value, Vector vector)
  * vec1: First vector with which the dot product is calculated.
  * vec2: Second vector with which the dot product is calculated.
  */
-long double do_dot_product(Vector vec1, Vector vec2)
+Real do_dot_product(Vector vec1, Vector vec2)
 {
 	return vec1.x * vec2.x + vec1.y * vec2.y + vec1.z * vec2.z;
 }
@@ -181,18 +190,18 @@ VECTOR CrossProduct(VECTOR vec1, VECTOR vec2)
 // described by the given cuadratic function. The first distance is the
 // nearest, the second is the farthest.
 // If the object doesn't have an intersection it returns a NULL pointer.
-long double* CuadraticFunctionBoth(long double a, long double b, long double c)
+Real* CuadraticFunctionBoth(Real a, Real b, Real c)
 {
-	long double * distances = GetMemory(sizeof(long double) * 2, NULL);
-	long double discr = pow(b, 2) - 4 * a * c;
+	Real * distances = GetMemory(sizeof(Real) * 2, NULL);
+	Real discr = real_pow(b, 2) - 4 * a * c;
 	// There isn't any intersection
 	if (discr < 0)
 		return NULL;
 	else
 	{
-		long double sqrt_disc = sqrt(discr);
-		long double t1 = (- b - sqrt_disc) / (2 * a);
-		long double t2 = (- b + sqrt_disc) / (2 * a);
+		Real sqrt_disc = real_sqrt(discr);
+		Real t1 = (- b - sqrt_disc) / (2 * a);
+		Real t2 = (- b + sqrt_disc) / (2 * a);
 		// Object in front of us
 		if(t1 > 0 && t2 > 0)
 		{
@@ -1,6 +1,8 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "real.h"
+
 #define INVALID_DISTANCE -1
 
 /*
@@ -12,18 +14,19 @@
  */
 typedef struct
 {
-	long double x;
-	long double y;
-	long double z;
+	Real x;
+	Real y;
+	Real z;
 } Vector;
 
-int is_one_distance(long double *distances);
-long double normalize_vector(Vector *vector);
-long double* do_cuadratic_function(long double a, long double b, long double c);
-Vector get_ray_position(Vector anchor, Vector dir, long double distance);
+int is_one_distance(Real *distances);
+Real get_vector_length(Vector vector);
+Real normalize_vector(Vector *vector);
+int do_cuadratic_function(Real a, Real b, Real c, Real *distances);
+Vector get_ray_position(Vector anchor, Vector dir, Real distance);
 Vector subtract_vectors(Vector vector, Vector subtracting_vector);
-Vector multiply_vector(long double scalar_value, Vector vector);
-long double do_dot_product(Vector vec1, Vector vec2);
+Vector multiply_vector(Real scalar_value, Vector vector);
+Real do_dot_product(Vector vec1, Vector vec2);
 Vector do_cross_product(Vector vec1, Vector vec2);
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include "real.h"
+
 /*
  * Represents the window that peeks at the tridimensional scene
  *
@@ -12,11 +14,11 @@
  */
 typedef struct
 {
-	long double x_max;
-	long double x_min;
-	long double y_max;
-	long double y_min;
-	long double z_anchor;
+	Real x_max;
+	Real x_min;
+	Real y_max;
+	Real y_min;
+	Real z_anchor;
 } Window;
 
 #endif
@@ -19,6 +19,14 @@
 #define MISSSING_CONFIGURATION_FILE_MSG "USER ERROR: You must provide a configuration file named \"scene.cfg\" at the root of the project.\n"
 #define MISSSING_CONFIGURATION_ATTR_MSG "USER ERROR: Missing a configuration attribute in \"scene.cfg\".\n"
 #define MISSING_VERTEX_MSG "USER ERROR: All polygons must have at least 3 vertex.\n"
+#define TRANSPARENCY_LEVEL_MSG "USER ERROR: The maximum transparency level is too large.\n"
+#define MESH_FORMAT_MSG "USER ERROR: Invalid vertex or face in the mesh file.\n"
+#define INSTANCE_MSG "USER ERROR: Instances must use a previous geometry and a scale without zeros.\n"
+#define HEIGHTFIELD_FORMAT_MSG "USER ERROR: Heightfields need at least 2x2 samples, and a file with a float for each one.\n"
+#define PARTICLES_FORMAT_MSG "USER ERROR: The particle file is empty or its size doesn't match its header.\n"
+#define ANTIALIASE_METRIC_MSG "USER ERROR: The antialiasing metric must be \"channel\", \"luminance\" or \"delta_e\".\n"
+#define SAMPLING_CONFIG_MSG "USER ERROR: Invalid antialiasing mode, sample pattern, pixel filter or number of pixel samples.\n"
+#define IMAGE_WRITE_MSG "USER ERROR: The image couldn't be written (the disk may be full).\n"
 
 char *ERROR_MESSAGES[] =
 {
@@ -29,7 +37,15 @@ char *ERROR_MESSAGES[] =
 	UNDEFINED_TYPE_MSG,
 	MISSSING_CONFIGURATION_FILE_MSG,
 	MISSSING_CONFIGURATION_ATTR_MSG,
-	MISSING_VERTEX_MSG
+	MISSING_VERTEX_MSG,
+	TRANSPARENCY_LEVEL_MSG,
+	MESH_FORMAT_MSG,
+	INSTANCE_MSG,
+	HEIGHTFIELD_FORMAT_MSG,
+	PARTICLES_FORMAT_MSG,
+	ANTIALIASE_METRIC_MSG,
+	SAMPLING_CONFIG_MSG,
+	IMAGE_WRITE_MSG
 };
 
 // Methods
@@ -11,6 +11,14 @@
 #define MISSING_CONFIGURATION_FILE_ERROR 5
 #define MISSING_CONFIGURATION_ATTR_ERROR 6
 #define MISSING_VERTEX_ERROR 7
+#define TRANSPARENCY_LEVEL_ERROR 8
+#define MESH_FORMAT_ERROR 9
+#define INSTANCE_ERROR 10
+#define HEIGHTFIELD_FORMAT_ERROR 11
+#define PARTICLES_FORMAT_ERROR 12
+#define ANTIALIASE_METRIC_ERROR 13
+#define SAMPLING_CONFIG_ERROR 14
+#define IMAGE_WRITE_ERROR 15
 
 void print_error(int error_code);
 void* throw_config_error(config_setting_t *setting, char *attr_path, char *attr_type);
@@ -1,17 +1,23 @@
 /* file_handler.c
  * 		Copyright 2012 Carlos Fernandez
  *
- * This program writes an array of Color structures into a .bmp image and
- * manages all the file related operations of the ray tracer.
+ * This program writes the painted Color structures into a .bmp image, while
+ * the image is being painted, and manages all the file related operations of
+ * the ray tracer.
  */
 
 // Headers
+// 64 bit file offsets on 32 bit systems too, so large images can be written
+#define _FILE_OFFSET_BITS 64
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
+#include <pthread.h>
 #include "memory_handler.h"
+#include "error_handler.h"
+#include "file_handler.h"
 #include "../tracing/color.h"
 
 // Structures and constants
@@ -45,19 +51,48 @@ typedef struct tagBMPInfoHeader
 // Methods
 
 /*
- * Writes an image with the 'image.bmp' name in the root of the program.
- * The image will have a resolution of 'width' * 'height'.
+ * Prints the write error of the image and exits the program.
+ */
+void throw_image_write_error()
+{
+    print_error(IMAGE_WRITE_ERROR);
+    printf("File 'image.bmp'");
+    exit(IMAGE_WRITE_ERROR);
+}
+
+/*
+ * Moves to a position of the image file. The position has 64 bits even where
+ * 'long' has 32, so it doesn't wrap on large images. If it fails, it prints
+ * the write error and exits the program.
+ *
+ * file: File of the image.
+ * posn: Position from the beginning of the file, in bytes.
+ */
+void seek_image_file(FILE *file, int64_t posn)
+{
+#ifdef _WIN32
+    if(_fseeki64(file, posn, SEEK_SET)) throw_image_write_error();
+#else
+    if(fseeko(file, (off_t) posn, SEEK_SET)) throw_image_write_error();
+#endif
+}
+
+/*
+ * Writes the headers of an image with a resolution of 'width' * 'height', and
+ * makes the file as large as the whole image. Returns the position of the
+ * pixels in the file. If the file can't be written, it prints the error and
+ * exits the program.
  *
- * pixels: Pixels of the image. Length of the array must be height * width.
+ * file: File of the image, opened for writing.
  * height: Number of pixel rows on the image.
  * width: Number of pixel columns on the image.
  */
-void create_image (Color * pixels, int height, int width)
+int64_t write_image_headers(FILE *file, int height, int width)
 {
     // Prepare image headers
 	BMPFileHeader bitmap_file_header;
 	BMPInfoHeader bitmap_info_header;
-	int imagebytes=width*height*3;
+	int64_t imagebytes=(int64_t)width*height*3;
 	char magic[2]="BM";
 	bitmap_file_header.bfSize = 2+sizeof(BMPFileHeader)+sizeof(BMPInfoHeader)+imagebytes;
 	bitmap_file_header.bfReserved1 = 0;
@@ -74,30 +109,184 @@ void create_image (Color * pixels, int height, int width)
 	bitmap_info_header.biYPelsPerMeter = 2835;
 	bitmap_info_header.biClrUsed = 0;
 	bitmap_info_header.biClrImportant = 0;
-	// Prepare image data
-	char *imagedata = get_memory(imagebytes, NULL);
-	int x,y;
-	#define B imagedata[((y*width)+x)*3]
-	#define G imagedata[((y*width)+x)*3+1]
-	#define R imagedata[((y*width)+x)*3+2]
-	int color_counter = 0;
-	for(y=0;y<height;++y)
+	// Write headers
+	if(fwrite(magic, 2, 1, file) != 1 ||
+	   fwrite((void*)&bitmap_file_header, sizeof(BMPFileHeader), 1, file) != 1 ||
+	   fwrite((void*)&bitmap_info_header, sizeof(BMPInfoHeader), 1, file) != 1)
+		throw_image_write_error();
+	// The last byte gives the file its size, the blocks are written in between
+	if(imagebytes > 0)
 	{
-		for(x=0;x<width;++x)
-		{
-			R= (char) round(255*pixels[color_counter].red);
-			G= (char) round(255*pixels[color_counter].green);
-			B= (char) round(255*pixels[color_counter].blue);
-			color_counter++;
-		}
+		seek_image_file(file, bitmap_file_header.bfOffBits + imagebytes - 1);
+		if(fputc(0, file) == EOF) throw_image_write_error();
 	}
-	// Write file
-	FILE *f = fopen("image.bmp","wb");
-	fwrite(magic, 2, 1, f);
-	fwrite((void*)&bitmap_file_header, sizeof(BMPFileHeader), 1, f);
-	fwrite((void*)&bitmap_info_header, sizeof(BMPInfoHeader), 1, f);
-	fwrite(imagedata, bitmap_info_header.biSizeImage, 1, f);
-	fclose(f);
-	free(imagedata);
+	return bitmap_file_header.bfOffBits;
 }
 
+/*
+ * Encodes the pixels of a block and writes them at their place in the file.
+ * Rows go from the bottom of the image to the top, like the rows of the
+ * painted image, so every row of the block is written with a single write.
+ * If it fails, it prints the write error and exits the program.
+ *
+ * writer: Writer of the image.
+ * block: Block that is written.
+ */
+void write_image_block(ImageWriter *writer, const ImageBlock *block)
+{
+    const Color *pixel;
+    int x, y;
+
+    for(y = 0; y < block->height; y++)
+    {
+        pixel = &block->pixels[y * writer->block_size];
+        for(x = 0; x < block->width; x++, pixel++)
+        {
+            writer->row_data[x * 3] = (char) round(255*pixel->blue);
+            writer->row_data[x * 3 + 1] = (char) round(255*pixel->green);
+            writer->row_data[x * 3 + 2] = (char) round(255*pixel->red);
+        }
+        seek_image_file(writer->file, writer->data_offset + ((int64_t) (block->h_begin + y) * writer->width + block->w_begin) * 3);
+        if(fwrite(writer->row_data, block->width * 3, 1, writer->file) != 1) throw_image_write_error();
+    }
+}
+
+/*
+ * Writer thread routine. Writes the blocks as they are put, until the writer
+ * is closing and there are no pending blocks.
+ *
+ * writer_ptr: Pointer to the ImageWriter struct of the image.
+ */
+void* run_image_writer(void *writer_ptr)
+{
+    ImageWriter *writer = (ImageWriter*) writer_ptr;
+    ImageBlock *block;
+
+    pthread_mutex_lock(&writer->lock);
+    while(1)
+    {
+        while(writer->pending_length == 0 && !writer->closing)
+            pthread_cond_wait(&writer->block_put, &writer->lock);
+        if(writer->pending_length == 0) break;
+        block = writer->pending_blocks[writer->pending_first];
+        writer->pending_first = (writer->pending_first + 1) % writer->blocks_length;
+        writer->pending_length--;
+        // The block is only used by this thread until it is freed
+        pthread_mutex_unlock(&writer->lock);
+        write_image_block(writer, block);
+        pthread_mutex_lock(&writer->lock);
+        writer->free_blocks[writer->free_length++] = block;
+        pthread_cond_signal(&writer->block_freed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/*
+ * Opens an image with the 'image.bmp' name in the root of the program, and
+ * starts the thread that writes it. The image will have a resolution of
+ * 'width' * 'height'.
+ *
+ * writer: Output parameter for the writer of the image. It must not be moved while it is open.
+ * height: Number of pixel rows on the image.
+ * width: Number of pixel columns on the image.
+ * block_size: Maximum width and height of the blocks of pixels.
+ * blocks_length: Number of blocks of the writer. With twice as many blocks as painting threads,
+ *                the painting doesn't wait for the writing.
+ */
+void open_image(ImageWriter *writer, int height, int width, int block_size, int blocks_length)
+{
+    int block_i;
+
+    writer->file = fopen("image.bmp", "wb");
+    if(!writer->file)
+    {
+        print_error(OPEN_FILE_ERROR);
+        printf("File 'image.bmp'");
+        exit(OPEN_FILE_ERROR);
+    }
+    writer->data_offset = write_image_headers(writer->file, height, width);
+    writer->width = width;
+    writer->height = height;
+    writer->block_size = block_size;
+    writer->blocks_length = blocks_length;
+    writer->blocks = get_memory(sizeof(ImageBlock) * blocks_length, NULL);
+    writer->free_blocks = get_memory(sizeof(ImageBlock*) * blocks_length, NULL);
+    writer->pending_blocks = get_memory(sizeof(ImageBlock*) * blocks_length, NULL);
+    for(block_i = 0; block_i < blocks_length; block_i++)
+    {
+        writer->blocks[block_i].pixels = get_memory(sizeof(Color) * block_size * block_size, NULL);
+        writer->free_blocks[block_i] = &writer->blocks[block_i];
+    }
+    writer->free_length = blocks_length;
+    writer->pending_first = writer->pending_length = 0;
+    writer->row_data = get_memory(block_size * 3, NULL);
+    writer->closing = 0;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->block_freed, NULL);
+    pthread_cond_init(&writer->block_put, NULL);
+    pthread_create(&writer->thread, NULL, &run_image_writer, writer);
+}
+
+/*
+ * Takes a free block of pixels, waiting for the writer if every block is
+ * pending.
+ *
+ * writer: Writer of the image.
+ */
+ImageBlock* take_image_block(ImageWriter *writer)
+{
+    ImageBlock *block;
+
+    pthread_mutex_lock(&writer->lock);
+    while(writer->free_length == 0)
+        pthread_cond_wait(&writer->block_freed, &writer->lock);
+    block = writer->free_blocks[--writer->free_length];
+    pthread_mutex_unlock(&writer->lock);
+    return block;
+}
+
+/*
+ * Puts a painted block of pixels, so it is written to the image. The block
+ * can't be used after this call.
+ *
+ * writer: Writer of the image.
+ * block: Painted block, taken with 'take_image_block'. Its position and size must be set.
+ */
+void put_image_block(ImageWriter *writer, ImageBlock *block)
+{
+    pthread_mutex_lock(&writer->lock);
+    writer->pending_blocks[(writer->pending_first + writer->pending_length) % writer->blocks_length] = block;
+    writer->pending_length++;
+    pthread_cond_signal(&writer->block_put);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/*
+ * Waits until every block that was put is written, and closes the image.
+ * Frees the memory used by the writer. If the image can't be written, it
+ * prints the error and exits the program.
+ *
+ * writer: Writer of the image.
+ */
+void close_image(ImageWriter *writer)
+{
+    int block_i;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->closing = 1;
+    pthread_cond_signal(&writer->block_put);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    // Buffered data is written when the file is closed, so it can fail too
+    if(fclose(writer->file)) throw_image_write_error();
+    pthread_cond_destroy(&writer->block_put);
+    pthread_cond_destroy(&writer->block_freed);
+    pthread_mutex_destroy(&writer->lock);
+    for(block_i = 0; block_i < writer->blocks_length; block_i++)
+        free(writer->blocks[block_i].pixels);
+    free(writer->blocks);
+    free(writer->free_blocks);
+    free(writer->pending_blocks);
+    free(writer->row_data);
+}
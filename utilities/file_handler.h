@@ -1,8 +1,82 @@
 #ifndef FILE_HANDLER_H
 #define FILE_HANDLER_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "../tracing/color.h"
 
-void create_image (Color * pixels, int height, int width);
+/*
+ * Represents a block of pixels of the image, which is written as soon as it
+ * is painted.
+ *
+ * pixels: Pixels of the block, row after row. Every row takes 'block_size' pixels (see ImageWriter),
+ *         even if the block is narrower.
+ * w_begin: Horizontal position of the first pixel of the block in the image.
+ * h_begin: Vertical position of the first pixel of the block in the image.
+ * width: Number of pixel columns of the block.
+ * height: Number of pixel rows of the block.
+ */
+typedef struct
+{
+    Color *pixels;
+    int w_begin;
+    int h_begin;
+    int width;
+    int height;
+} ImageBlock;
+
+/*
+ * Writes the image while it is being painted. The file is sized when it is
+ * opened, so every block can be written at its place as soon as it is put,
+ * in any order. The blocks are encoded and written by a thread of the
+ * writer, and only a few of them exist, so the whole image is never kept in
+ * memory.
+ *
+ * file: File of the image.
+ * data_offset: Position of the pixels in the file.
+ * width: Number of pixel columns of the image.
+ * height: Number of pixel rows of the image.
+ * block_size: Maximum width and height of a block.
+ * blocks: Every block of the writer, either free or pending.
+ * blocks_length: Number of blocks of the writer.
+ * free_blocks: Stack of the blocks that can be taken.
+ * free_length: Number of free blocks.
+ * pending_blocks: Queue (circular) of the blocks that have been put and are not written yet.
+ * pending_first: Position of the first pending block.
+ * pending_length: Number of pending blocks.
+ * row_data: Encoded pixels of a row of a block.
+ * closing: True when no more blocks will be put.
+ * lock: Protects the free and pending blocks, and 'closing'.
+ * block_freed: Signaled when a block is written and becomes free.
+ * block_put: Signaled when a block is put, or the writer is closing.
+ * thread: Thread that encodes and writes the blocks.
+ */
+typedef struct
+{
+    FILE *file;
+    int64_t data_offset;
+    int width;
+    int height;
+    int block_size;
+    ImageBlock *blocks;
+    int blocks_length;
+    ImageBlock **free_blocks;
+    int free_length;
+    ImageBlock **pending_blocks;
+    int pending_first;
+    int pending_length;
+    char *row_data;
+    int closing;
+    pthread_mutex_t lock;
+    pthread_cond_t block_freed;
+    pthread_cond_t block_put;
+    pthread_t thread;
+} ImageWriter;
+
+void open_image(ImageWriter *writer, int height, int width, int block_size, int blocks_length);
+ImageBlock* take_image_block(ImageWriter *writer);
+void put_image_block(ImageWriter *writer, ImageBlock *block);
+void close_image(ImageWriter *writer);
 
 #endif
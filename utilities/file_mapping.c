@@ -0,0 +1,105 @@
+/* file_mapping.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Maps binary files in memory, so their data can be used without reading it.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "error_handler.h"
+#include "file_mapping.h"
+
+// Methods
+
+/*
+ * Prints the open file error for a file and exits the program.
+ *
+ * file_path: Path of the file that couldn't be mapped.
+ */
+void throw_mapping_error(const char *file_path)
+{
+    print_error(OPEN_FILE_ERROR);
+    printf("File '%s'", file_path);
+    exit(OPEN_FILE_ERROR);
+}
+
+/*
+ * Maps a whole file in memory, read only, and returns the address of its first
+ * byte. The pages are loaded by the system when they are used, so large files
+ * don't need to be read or copied. The mapping lasts until it is unmapped.
+ * Returns NULL for empty files. If the file can't be mapped, or it doesn't fit
+ * in the address space, it prints the corresponding error message and exits
+ * the program.
+ *
+ * file_path: Path of the file.
+ * size: Output parameter for the number of bytes of the file.
+ */
+const void* map_file(const char *file_path, size_t *size)
+{
+    const void *data;
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER file_size;
+
+    file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) ||
+       (unsigned long long) file_size.QuadPart > SIZE_MAX)
+        throw_mapping_error(file_path);
+    *size = (size_t) file_size.QuadPart;
+    if(!*size)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!mapping) throw_mapping_error(file_path);
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data) throw_mapping_error(file_path);
+    // The view keeps the file mapped after the handles are closed
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    struct stat file_stat;
+    int file;
+
+    file = open(file_path, O_RDONLY);
+    if(file < 0 || fstat(file, &file_stat) < 0 || (unsigned long long) file_stat.st_size > SIZE_MAX)
+        throw_mapping_error(file_path);
+    *size = (size_t) file_stat.st_size;
+    if(!*size)
+    {
+        close(file);
+        return NULL;
+    }
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+    if(data == MAP_FAILED) throw_mapping_error(file_path);
+    // The mapping stays valid after the file is closed
+    close(file);
+#endif
+    return data;
+}
+
+/*
+ * Unmaps a file mapped with 'map_file'.
+ *
+ * data: Address of the first byte of the mapped file.
+ * size: Number of bytes of the file.
+ */
+void unmap_file(const void *data, size_t size)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap((void*) data, size);
+#endif
+}
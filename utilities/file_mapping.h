@@ -0,0 +1,9 @@
+#ifndef FILE_MAPPING_H
+#define FILE_MAPPING_H
+
+#include <stddef.h>
+
+const void* map_file(const char *file_path, size_t *size);
+void unmap_file(const void *data, size_t size);
+
+#endif
@@ -9,8 +9,20 @@
 #include <stdlib.h>
 #include "error_handler.h"
 
+// Number of allocations made through 'get_memory'. Shared by all the threads.
+static unsigned long allocation_count = 0;
+
 // Methods
 
+/*
+ * Returns the number of allocations made through 'get_memory' so far. It is
+ * used to check that painting the scene doesn't need the heap.
+ */
+unsigned long get_allocation_count()
+{
+	return __sync_fetch_and_add(&allocation_count, 0);
+}
+
 /*
  * Assigns the requested number of bytes from the heap memory. If there is a
  * memory error, it prints the corresponding error message and exits the
@@ -22,6 +34,7 @@
 void* get_memory(unsigned long n, void (*error_routine)())
 {
 	void* mem_pointer = malloc(n);
+	__sync_fetch_and_add(&allocation_count, 1);
 	if(!mem_pointer)
 	{
 		print_error(MEMORY_ALLOCATION_ERROR);
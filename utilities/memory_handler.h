@@ -2,5 +2,6 @@
 #define MEMORY_HANDLER_H
 
 void* get_memory(unsigned long n, void (*error_routine)());
+unsigned long get_allocation_count();
 
 #endif
@@ -0,0 +1,92 @@
+/* work_queue.c
+ * 		Copyright 2012 Carlos Fernandez
+ *
+ * Distributes work items (like image tiles) between several worker threads.
+ */
+
+// Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "memory_handler.h"
+#include "work_queue.h"
+
+// Methods
+
+/*
+ * Creates a work-stealing queue with the items 0 to 'items_length' - 1. The
+ * items are split in contiguous blocks, one block per deque, so every worker
+ * starts with neighbouring items.
+ *
+ * deques_length: Number of workers that will take items from the queue.
+ * items_length: Number of items in the queue.
+ */
+WorkQueue create_work_queue(int deques_length, int items_length)
+{
+    WorkQueue queue;
+    WorkDeque *deque;
+    int deque_i, item_i, first_item, last_item;
+
+    queue.deques_length = deques_length;
+    queue.deques = get_memory(sizeof(WorkDeque) * deques_length, NULL);
+    for(deque_i = 0; deque_i < deques_length; deque_i++)
+    {
+        deque = &queue.deques[deque_i];
+        first_item = (long) items_length * deque_i / deques_length;
+        last_item = (long) items_length * (deque_i + 1) / deques_length;
+        deque->items = get_memory(sizeof(int) * (last_item - first_item + 1), NULL);
+        deque->head = 0;
+        deque->tail = 0;
+        for(item_i = first_item; item_i < last_item; item_i++)
+            deque->items[deque->tail++] = item_i;
+        pthread_mutex_init(&deque->lock, NULL);
+    }
+    return queue;
+}
+
+/*
+ * Takes the next item from the front of the given deque. If the deque is
+ * empty, it steals the last item of another deque. Returns -1 when there are
+ * no pending items on the whole queue.
+ *
+ * queue: Queue from which the item is taken.
+ * deque_index: Index of the deque that belongs to the calling worker.
+ */
+int get_work_item(WorkQueue *queue, int deque_index)
+{
+    WorkDeque *deque;
+    int item, victim_i;
+
+    // Take our own work first, in order
+    deque = &queue->deques[deque_index];
+    pthread_mutex_lock(&deque->lock);
+    item = deque->head < deque->tail ? deque->items[deque->head++] : -1;
+    pthread_mutex_unlock(&deque->lock);
+    // Steal from the back of the other workers
+    for(victim_i = 1; item < 0 && victim_i < queue->deques_length; victim_i++)
+    {
+        deque = &queue->deques[(deque_index + victim_i) % queue->deques_length];
+        pthread_mutex_lock(&deque->lock);
+        if(deque->head < deque->tail) item = deque->items[--deque->tail];
+        pthread_mutex_unlock(&deque->lock);
+    }
+    return item;
+}
+
+/*
+ * Frees the memory used by a work queue.
+ *
+ * queue: Queue that will be destroyed.
+ */
+void destroy_work_queue(WorkQueue *queue)
+{
+    int deque_i;
+    for(deque_i = 0; deque_i < queue->deques_length; deque_i++)
+    {
+        pthread_mutex_destroy(&queue->deques[deque_i].lock);
+        free(queue->deques[deque_i].items);
+    }
+    free(queue->deques);
+    queue->deques = NULL;
+    queue->deques_length = 0;
+}
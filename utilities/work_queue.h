@@ -0,0 +1,39 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <pthread.h>
+
+/*
+ * Represents the list of work items that belongs to a single worker.
+ *
+ * items: Work items (indexes) that are pending.
+ * head: Position of the next item that the owner of the deque will take.
+ * tail: Position after the last pending item. Other workers steal from here.
+ * lock: Protects the head and tail of the deque.
+ */
+typedef struct
+{
+    int *items;
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} WorkDeque;
+
+/*
+ * Represents a work-stealing queue. Every worker has its own deque, and when
+ * it runs out of work it steals items from the back of the other deques.
+ *
+ * deques: One deque per worker.
+ * deques_length: Number of workers (deques) in the queue.
+ */
+typedef struct
+{
+    WorkDeque *deques;
+    int deques_length;
+} WorkQueue;
+
+WorkQueue create_work_queue(int deques_length, int items_length);
+int get_work_item(WorkQueue *queue, int deque_index);
+void destroy_work_queue(WorkQueue *queue);
+
+#endif